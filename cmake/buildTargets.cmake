@@ -3,8 +3,67 @@ target_include_directories(wdm INTERFACE
         $<BUILD_INTERFACE:${PROJECT_SOURCE_DIR}/include>
         $<INSTALL_INTERFACE:include>
         )
+find_package(Threads REQUIRED)
+target_link_libraries(wdm INTERFACE Threads::Threads)
+if(WDM_PROFILING)
+    target_compile_definitions(wdm INTERFACE WDM_PROFILING)
+endif()
+
+if(WDM_BUILD_C_LIBRARY)
+    add_library(wdm_c SHARED ${PROJECT_SOURCE_DIR}/src/wdm_c.cpp)
+    target_link_libraries(wdm_c PRIVATE wdm)
+    target_include_directories(wdm_c PUBLIC
+            $<BUILD_INTERFACE:${PROJECT_SOURCE_DIR}/include>
+            $<INSTALL_INTERFACE:include>
+            )
+    target_compile_definitions(wdm_c PRIVATE
+            WDM_C_BUILDING WDM_VERSION="${PROJECT_VERSION}")
+    set_target_properties(wdm_c PROPERTIES
+            CXX_VISIBILITY_PRESET hidden
+            VISIBILITY_INLINES_HIDDEN ON
+            VERSION ${PROJECT_VERSION}
+            SOVERSION ${PROJECT_VERSION_MAJOR}
+            )
+endif()
+
+if(WDM_BUILD_LIBRARY)
+    # the kernels are compiled once; targets linking the libraries get
+    # WDM_COMPILED and reference these instantiations instead of their own
+    add_library(wdm_static STATIC ${PROJECT_SOURCE_DIR}/src/wdm_lib.cpp)
+    add_library(wdm_shared SHARED ${PROJECT_SOURCE_DIR}/src/wdm_lib.cpp)
+    foreach(target wdm_static wdm_shared)
+        target_link_libraries(${target} PUBLIC wdm)
+        target_compile_definitions(${target}
+                PRIVATE WDM_LIB_BUILDING
+                INTERFACE WDM_COMPILED)
+    endforeach()
+    set_target_properties(wdm_shared PROPERTIES
+            WINDOWS_EXPORT_ALL_SYMBOLS ON
+            VERSION ${PROJECT_VERSION}
+            SOVERSION ${PROJECT_VERSION_MAJOR}
+            )
+    include(CheckIPOSupported)
+    check_ipo_supported(RESULT wdm_ipo_supported OUTPUT wdm_ipo_output)
+    if(wdm_ipo_supported)
+        set_target_properties(wdm_shared PROPERTIES
+                INTERPROCEDURAL_OPTIMIZATION ON)
+    endif()
+endif()
+
+if(WDM_BUILD_CLI)
+    find_package(Eigen3 3.3 REQUIRED NO_MODULE)
+elseif(BUILD_TESTING)
+    # the tests build and run wdm-cli whenever Eigen is available
+    find_package(Eigen3 3.3 QUIET NO_MODULE)
+endif()
+if(TARGET Eigen3::Eigen)
+    add_executable(wdm-cli ${PROJECT_SOURCE_DIR}/src/wdm_cli.cpp)
+    target_link_libraries(wdm-cli PRIVATE wdm Eigen3::Eigen)
+    target_compile_definitions(wdm-cli PRIVATE WDM_VERSION="${PROJECT_VERSION}")
+endif()
 
 if(BUILD_TESTING)
+    enable_testing()
     set(EXECUTABLE_OUTPUT_PATH ${PROJECT_BINARY_DIR}/bin)
     add_subdirectory(test)
 endif(BUILD_TESTING)
@@ -49,6 +108,27 @@ configure_package_config_file(
 
 # Targets:
 install(TARGETS wdm EXPORT "${targets_export_name}")
+if(WDM_BUILD_C_LIBRARY)
+    install(TARGETS wdm_c EXPORT "${targets_export_name}"
+            LIBRARY DESTINATION lib
+            ARCHIVE DESTINATION lib
+            RUNTIME DESTINATION bin
+            )
+    install(FILES ${PROJECT_SOURCE_DIR}/include/wdm_c.h
+            DESTINATION "${include_install_dir}")
+endif()
+if(WDM_BUILD_LIBRARY)
+    install(TARGETS wdm_static wdm_shared EXPORT "${targets_export_name}"
+            LIBRARY DESTINATION lib
+            ARCHIVE DESTINATION lib
+            RUNTIME DESTINATION bin
+            )
+    install(FILES ${PROJECT_SOURCE_DIR}/include/wdm_lib.hpp
+            DESTINATION "${include_install_dir}")
+endif()
+if(WDM_BUILD_CLI)
+    install(TARGETS wdm-cli RUNTIME DESTINATION bin)
+endif()
 
 
 file(GLOB_RECURSE main_hpp ${PROJECT_SOURCE_DIR}/include/wdm.hpp)
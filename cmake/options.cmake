@@ -8,4 +8,8 @@ endif()
 option(WARNINGS_AS_ERRORS        "Compiler warnings as errors"       "OFF")
 option(OPT_ASAN                  "Use adress sanitizer (debug)"      "ON")
 option(BUILD_TESTING             "Build tests."                      "ON")
-option(CODE_COVERAGE             "Code coverage."                    "OFF")
\ No newline at end of file
+option(CODE_COVERAGE             "Code coverage."                    "OFF")
+option(WDM_PROFILING             "Phase-level instrumentation."      "OFF")
+option(WDM_BUILD_C_LIBRARY       "Build the shared C library."       "OFF")
+option(WDM_BUILD_LIBRARY         "Build the compiled libraries."     "OFF")
+option(WDM_BUILD_CLI             "Build the wdm-cli tool (needs Eigen)." "OFF")
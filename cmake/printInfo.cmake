@@ -14,4 +14,8 @@ message( STATUS "CMAKE_CXX_FLAGS_RELEASE=       ${CMAKE_CXX_FLAGS_RELEASE}")
 message( STATUS )
 message( STATUS "BUILD_TESTING=                 ${BUILD_TESTING}")
 message( STATUS "CODE_COVERAGE=                 ${CODE_COVERAGE}")
+message( STATUS "WDM_PROFILING=                 ${WDM_PROFILING}")
+message( STATUS "WDM_BUILD_C_LIBRARY=           ${WDM_BUILD_C_LIBRARY}")
+message( STATUS "WDM_BUILD_LIBRARY=             ${WDM_BUILD_LIBRARY}")
+message( STATUS "WDM_BUILD_CLI=                 ${WDM_BUILD_CLI}")
 message( STATUS )
\ No newline at end of file
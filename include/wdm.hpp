@@ -11,18 +11,68 @@
 #include "wdm/prho.hpp"
 #include "wdm/srho.hpp"
 #include "wdm/bbeta.hpp"
+#include "wdm/dcor.hpp"
+#include "wdm/xi.hpp"
 #include "wdm/methods.hpp"
 #include "wdm/nan_handling.hpp"
+#include "wdm/all.hpp"
+#include "wdm/multi.hpp"
+#include "wdm/matrix_ranks.hpp"
+#include "wdm/external.hpp"
+#include "wdm/small.hpp"
+#include "wdm/ktau_summary.hpp"
+#include "wdm/parallel.hpp"
+#include "wdm/lags.hpp"
+#include "wdm/hints.hpp"
+#include "wdm/instantiations.hpp"
 
 //! Weighted dependence measures
 namespace wdm {
 
+namespace impl {
+
+//! calculates a (weighted) dependence measure from data that have been
+//! checked against the hints and freed of missing values; see `wdm()`.
+//! @param x, y input data.
+//! @param method the dependence measure.
+//! @param weights vector of weights for the data; can be empty.
+//! @param hints properties of the data.
+inline double wdm_hinted(const std::vector<double>& x,
+                         const std::vector<double>& y,
+                         const std::string& method,
+                         const std::vector<double>& weights,
+                         const Data_hints& hints)
+{
+    if (methods::is_hoeffding(method))
+        return hoeffd(x, y, weights);
+    if (methods::is_kendall(method))
+        return ktau(x, y, weights, hints);
+    if (methods::is_pearson(method))
+        return prho(x, y, weights);
+    if (methods::is_spearman(method))
+        return srho(x, y, weights, hints);
+    if (methods::is_blomqvist(method))
+        return bbeta(x, y, weights, hints);
+    if (methods::is_distance(method))
+        return dcor(x, y, weights);
+    if (methods::is_xi(method))
+        return xi(x, y, weights);
+    throw std::runtime_error("method not implemented.");
+}
+
+}
+
 //! calculates (weighted) dependence measures.
 //! @param x, y input data.
 //! @param method the dependence measure; see details for possible values.
 //! @param weights an optional vector of weights for the data.
 //! @param remove_missing if `true`, all observations containing a `nan` are
 //!    removed; otherwise throws an error if `nan`s are present.
+//! @param hints properties of the data known to the caller (see
+//!    `Data_hints`); used by Kendall's \f$ \tau \f$, Spearman's
+//!    \f$ \rho \f$, and Blomqvist's \f$ \beta \f$ to skip sorting,
+//!    ranking, and tie counting, and by all methods to skip the scan for
+//!    missing values.
 //!
 //! @details
 //! Available methods:
@@ -31,32 +81,237 @@ namespace wdm {
 //!   - `"kendall"`, `"ktau"`, `"tau"`: Kendall's \f$ \tau \f$
 //!   - `"blomqvist"`, `"bbeta"`, `"beta"`: Blomqvist's \f$ \beta \f$
 //!   - `"hoeffding"`, `"hoeffd"`, `"d"`: Hoeffding's \f$ D \f$
+//!   - `"distance"`, `"dcor"`: distance correlation
+//!   - `"xi"`, `"chatterjee"`: Chatterjee's \f$ \xi \f$
 //!
 //! @return the dependence measure
 inline double wdm(std::vector<double> x,
                   std::vector<double> y,
                   std::string method,
                   std::vector<double> weights = std::vector<double>(),
-                  bool remove_missing = true)
+                  bool remove_missing = true,
+                  const Data_hints& hints = Data_hints())
 {
     utils::check_sizes(x, y, weights);
+    impl::check_hints(x, y, weights, hints);
     // na handling
-    if (utils::preproc(x, y, weights, method, remove_missing) == "return_nan")
+    if (utils::preproc(x, y, weights, method, remove_missing,
+                       hints.no_missing) == "return_nan")
         return std::numeric_limits<double>::quiet_NaN();
 
-    if (methods::is_hoeffding(method))
-        return impl::hoeffd(x, y, weights);
-    if (methods::is_kendall(method))
-        return impl::ktau(x, y, weights);
-    if (methods::is_pearson(method))
-        return impl::prho(x, y, weights);
-    if (methods::is_spearman(method))
-        return impl::srho(x, y, weights);
-    if (methods::is_blomqvist(method))
-        return impl::bbeta(x, y, weights);
-    throw std::runtime_error("method not implemented.");
+    return impl::wdm_hinted(x, y, method, weights, hints);
 }
 
+//! calculates a (weighted) dependence measure for many weight vectors.
+//!
+//! The data are sorted and ranked only once; the weighted estimates for all
+//! weight vectors share this work. For Kendall's \f$ \tau \f$ and Hoeffding's
+//! \f$ D \f$, discordances and bivariate ranks are counted for blocks of weight
+//! vectors simultaneously.
+//!
+//! @param x, y input data.
+//! @param method the dependence measure; see `wdm()` for possible values.
+//! @param weights a vector of weight vectors, each of the same size as `x`.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed (for each weight vector separately); otherwise throws an error
+//!    if `nan`s are present.
+//!
+//! @return a vector containing the dependence measure for each weight vector.
+inline std::vector<double> wdm_multi(std::vector<double> x,
+                                     std::vector<double> y,
+                                     std::string method,
+                                     std::vector<std::vector<double>> weights,
+                                     bool remove_missing = true)
+{
+    for (const auto& w : weights)
+        utils::check_sizes(x, y, w);
+    std::vector<double> res(weights.size());
+
+    // na handling for the data shared by all weight vectors
+    std::vector<double> no_weights;
+    std::vector<size_t> complete;
+    for (size_t i = 0; i < x.size(); i++) {
+        if (!std::isnan(x[i]) && !std::isnan(y[i]))
+            complete.push_back(i);
+    }
+    if (complete.size() < x.size()) {
+        if (!remove_missing)
+            utils::preproc(x, y, no_weights, method, remove_missing);
+        x = utils::permute(x, complete);
+        y = utils::permute(y, complete);
+        for (auto& w : weights)
+            w = utils::permute(w, complete);
+    }
+
+    // weight vectors with missing values are handled separately
+    std::vector<std::vector<double>> weights_ok;
+    std::vector<size_t> lanes_ok;
+    for (size_t l = 0; l < weights.size(); l++) {
+        if (utils::any_nan(weights[l])) {
+            res[l] = wdm(x, y, method, weights[l], remove_missing);
+        } else {
+            weights_ok.push_back(weights[l]);
+            lanes_ok.push_back(l);
+        }
+    }
+    if (lanes_ok.size() == 0)
+        return res;
+
+    if (utils::preproc(x, y, no_weights, method, remove_missing) == "return_nan") {
+        for (auto l : lanes_ok)
+            res[l] = std::numeric_limits<double>::quiet_NaN();
+        return res;
+    }
+    auto res_ok = impl::wdm_multi(x, y, method, weights_ok);
+    for (size_t k = 0; k < lanes_ok.size(); k++)
+        res[lanes_ok[k]] = res_ok[k];
+
+    return res;
+}
+
+namespace impl {
+
+//! calculates a (weighted) dependence measure from raw arrays.
+//!
+//! Samples without missing values are read in place by the kernels that do
+//! not reorder the data: Pearson's correlation and, for at most
+//! `small_n_max` observations, Kendall's \f$ \tau \f$ and Spearman's
+//! \f$ \rho \f$. All other cases are passed to `wdm()` on copies, since the
+//! kernels sort or rank the data.
+//! @param x, y pointers to the input data.
+//! @param weights pointer to the weights; `nullptr` stands for unit weights.
+//! @param n the number of observations.
+//! @param method, remove_missing see `wdm()`.
+inline double wdm_raw(const double* x,
+                      const double* y,
+                      const double* weights,
+                      size_t n,
+                      const std::string& method,
+                      bool remove_missing)
+{
+    bool complete = true;
+    for (size_t i = 0; (i < n) && complete; i++) {
+        if (std::isnan(x[i]) || std::isnan(y[i]) ||
+            (weights && std::isnan(weights[i])))
+            complete = false;
+    }
+
+    if (complete && (n >= methods::get_min_nobs(method))) {
+        if (methods::is_pearson(method))
+            return prho_raw(x, y, weights, n);
+        if (n <= small_n_max) {
+            if (methods::is_kendall(method))
+                return ktau_small(x, y, weights, n);
+            if (methods::is_spearman(method))
+                return srho_small(x, y, weights, n);
+        }
+    }
+    return wdm(std::vector<double>(x, x + n),
+               std::vector<double>(y, y + n),
+               method,
+               weights ? std::vector<double>(weights, weights + n)
+                       : std::vector<double>(),
+               remove_missing);
+}
+
+}
+
+//! calculates a (weighted) dependence measure for many samples stored
+//! contiguously.
+//!
+//! Sample `k` consists of the observations `offsets[k], ...,
+//! offsets[k + 1] - 1`. Samples of size at most 64 without missing values
+//! are processed by specialized kernels that compare all pairs instead of
+//! sorting (Kendall's \f$ \tau \f$ and Spearman's \f$ \rho \f$) and do not
+//! allocate memory; Pearson's correlation of complete samples of any size
+//! is computed in place; other samples are passed to `wdm()`.
+//!
+//! @param x, y pointers to the input data.
+//! @param offsets the start of each sample followed by the end of the last
+//!    sample; must be non-decreasing.
+//! @param method the dependence measure; see `wdm()` for possible values.
+//! @param weights pointer to the weights for the data; `nullptr` (default)
+//!    stands for unit weights.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed; otherwise throws an error if `nan`s are present.
+//! @param num_threads number of threads; `0` (default) uses all available
+//!    cores.
+//!
+//! @return a vector containing the dependence measure for each sample.
+inline std::vector<double> wdm_batch(const double* x,
+                                     const double* y,
+                                     const std::vector<size_t>& offsets,
+                                     std::string method,
+                                     const double* weights = nullptr,
+                                     bool remove_missing = true,
+                                     size_t num_threads = 0)
+{
+    if (!methods::is_hoeffding(method) && !methods::is_kendall(method) &&
+        !methods::is_pearson(method) && !methods::is_spearman(method) &&
+        !methods::is_blomqvist(method) && !methods::is_distance(method) &&
+        !methods::is_xi(method))
+        throw std::runtime_error("method not implemented.");
+    size_t m = (offsets.size() > 0) ? offsets.size() - 1 : 0;
+    for (size_t k = 0; k < m; k++) {
+        if (offsets[k] > offsets[k + 1])
+            throw std::runtime_error("offsets must be non-decreasing.");
+    }
+
+    std::vector<double> res(m);
+    utils::parallel_for(m, num_threads, [&] (size_t k, size_t) {
+        size_t first = offsets[k];
+        res[k] = impl::wdm_raw(x + first, y + first,
+                               weights ? weights + first : nullptr,
+                               offsets[k + 1] - first, method, remove_missing);
+    });
+
+    return res;
+}
+
+//! calculates a (weighted) dependence measure for many samples stored
+//! contiguously; see the pointer version of `wdm_batch()` for details.
+//! @param x, y input data.
+//! @param offsets the start of each sample followed by `x.size()`.
+//! @param method the dependence measure; see `wdm()` for possible values.
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed; otherwise throws an error if `nan`s are present.
+//! @param num_threads number of threads; `0` (default) uses all available
+//!    cores.
+inline std::vector<double> wdm_batch(const std::vector<double>& x,
+                                     const std::vector<double>& y,
+                                     const std::vector<size_t>& offsets,
+                                     std::string method,
+                                     const std::vector<double>& weights = std::vector<double>(),
+                                     bool remove_missing = true,
+                                     size_t num_threads = 0)
+{
+    utils::check_sizes(x, y, weights);
+    if ((offsets.size() > 0) && (offsets.back() != x.size()))
+        throw std::runtime_error("the last offset must be the size of the data.");
+    return wdm_batch(x.data(), y.data(), offsets, method,
+                     weights.size() > 0 ? weights.data() : nullptr,
+                     remove_missing, num_threads);
+}
+
+namespace impl {
+
+//! checks whether the exact null distributions of Kendall's \f$ \tau \f$
+//! and Spearman's \f$ \rho \f$ apply to a sample: it must be unweighted,
+//! free of ties, and small enough for the tables (ties are only checked in
+//! this case).
+//! @param x, y, weights input data (without missing values).
+inline bool use_exact_null(const std::vector<double>& x,
+                           const std::vector<double>& y,
+                           const std::vector<double>& weights)
+{
+    if ((weights.size() > 0) ||
+        (x.size() > std::max(ktau_exact_n_max, srho_exact_n_max)))
+        return false;
+    return !utils::has_ties(x) && !utils::has_ties(y);
+}
+
+}
 
 //! Independence test
 //!
@@ -70,6 +325,17 @@ inline double wdm(std::vector<double> x,
 //!   - `"kendall"`, `"ktau"`, `"tau"`: Kendall's \f$ \tau \f$
 //!   - `"blomqvist"`, `"bbeta"`, `"beta"`: Blomqvist's \f$ \beta \f$
 //!   - `"hoeffding"`, `"hoeffd"`, `"d"`: Hoeffding's \f$ D \f$
+//!   - `"distance"`, `"dcor"`: distance correlation
+//!   - `"xi"`, `"chatterjee"`: Chatterjee's \f$ \xi \f$
+//!
+//! For unweighted Kendall's \f$ \tau \f$ and Spearman's \f$ \rho \f$ on
+//! small samples without ties (at most 50 observations), the p-value is
+//! computed from the null distribution instead: exactly for Kendall's
+//! \f$ \tau \f$ and for Spearman's \f$ \rho \f$ with at most 9
+//! observations, and from an Edgeworth series otherwise. The null
+//! distributions are tabulated once, on first use. The test statistic is
+//! the asymptotic one in all cases. The same p-values are used by
+//! `wdm_all()`, `indep_test_matrix()`, and `indep_test_grouped()`.
 //!
 class Indep_test {
 public:
@@ -83,27 +349,94 @@ public:
     //! @param alternative indicates the alternative hypothesis and must be one
     //!    of `"two-sided"``, `"greater"` or `"less"`; `"greater"` corresponds
     //!    to positive association, `"less"` to negative association. For
-    //!    Hoeffding's \f$ D \f$, only `"two-sided"` is allowed.
+    //!    Hoeffding's \f$ D \f$ and the distance correlation, only
+    //!    `"two-sided"` is allowed. For Chatterjee's \f$ \xi \f$, which is
+    //!    positive under dependence, `"greater"` is the natural choice.
+    //! @param hints properties of the data known to the caller (see
+    //!    `Data_hints` and `wdm()`); without ties, the tie adjustment of
+    //!    Kendall's test statistic is skipped as well.
     Indep_test(std::vector<double> x,
                std::vector<double> y,
                std::string method,
                std::vector<double> weights = std::vector<double>(),
                bool remove_missing = true,
-               std::string alternative = "two-sided") :
+               std::string alternative = "two-sided",
+               const Data_hints& hints = Data_hints()) :
         method_(method),
         alternative_(alternative)
     {
         utils::check_sizes(x, y, weights);
-        if (utils::preproc(x, y, weights, method, remove_missing) == "return_nan") {
-            n_eff_ = utils::effective_sample_size(x.size(), weights);
+        impl::check_hints(x, y, weights, hints);
+        if (utils::preproc(x, y, weights, method, remove_missing,
+                           hints.no_missing) == "return_nan") {
+            n_eff_ = impl::effective_sample_size(x.size(), weights, hints);
             estimate_  = std::numeric_limits<double>::quiet_NaN();
             statistic_ = std::numeric_limits<double>::quiet_NaN();
             p_value_   = std::numeric_limits<double>::quiet_NaN();
         } else {
-            n_eff_ = utils::effective_sample_size(x.size(), weights);
-            estimate_ = wdm(x, y, method, weights, false);
-            statistic_ = compute_test_stat(estimate_, method, n_eff_, x, y, weights);
-            p_value_ = compute_p_value(statistic_, method, alternative, n_eff_);
+            n_eff_ = impl::effective_sample_size(x.size(), weights, hints);
+            estimate_ = impl::wdm_hinted(x, y, method, weights, hints);
+            bool no_ties = hints.no_ties || hints.ranked;
+            double stat_adjust = 0.0;
+            if (methods::is_kendall(method) && no_ties) {
+                impl::Tie_profile none = {0.0, 0.0, 0.0};
+                stat_adjust = impl::ktau_stat_adjust_from_ties(
+                    none, none, (weights.size() > 0) ?
+                        utils::power_sums(weights, 3) :
+                        utils::unit_power_sums(x.size(), 3));
+            } else if (methods::is_kendall(method)) {
+                stat_adjust = impl::ktau_stat_adjust(x, y, weights);
+            }
+            if (methods::is_distance(method))
+                stat_adjust = impl::dcor_stat_adjust(x, y, weights);
+            if (methods::is_xi(method))
+                stat_adjust = impl::xi_stat_adjust(y, weights);
+            bool exact_null = (methods::is_kendall(method) ||
+                               methods::is_spearman(method)) &&
+                (no_ties ? (weights.size() == 0)
+                         : impl::use_exact_null(x, y, weights));
+            statistic_ = compute_test_stat(estimate_, method, n_eff_, stat_adjust);
+            p_value_ = compute_p_value(estimate_, statistic_, method,
+                                       alternative, n_eff_, exact_null);
+        }
+    }
+
+    //! constructs the test from a precomputed estimate.
+    //! @param method the dependence measure; see class details for possible
+    //!    values.
+    //! @param estimate the estimated dependence measure; `nan` if the
+    //!    estimate is not available.
+    //! @param n_eff the effective sample size.
+    //! @param stat_adjust the adjustment of the test statistic: the tie
+    //!    adjustment for Kendall's \f$ \tau \f$ (see
+    //!    `impl::ktau_stat_adjust()`) or the scale adjustment for the distance
+    //!    correlation (see `impl::dcor_stat_adjust()`) or Chatterjee's
+    //!    \f$ \xi \f$ (see `impl::xi_stat_adjust()`); ignored for other
+    //!    methods.
+    //! @param alternative indicates the alternative hypothesis; see above.
+    //! @param exact_null whether the estimate stems from an unweighted sample
+    //!    of size `n_eff` without ties (see `impl::use_exact_null()`); for
+    //!    Kendall's \f$ \tau \f$ and Spearman's \f$ \rho \f$ in small
+    //!    samples, the p-value is then computed from the exact null
+    //!    distribution, as in the constructor from data.
+    Indep_test(std::string method,
+               double estimate,
+               double n_eff,
+               double stat_adjust,
+               std::string alternative = "two-sided",
+               bool exact_null = false) :
+        method_(method),
+        alternative_(alternative),
+        n_eff_(n_eff),
+        estimate_(estimate)
+    {
+        if (std::isnan(estimate)) {
+            statistic_ = std::numeric_limits<double>::quiet_NaN();
+            p_value_   = std::numeric_limits<double>::quiet_NaN();
+        } else {
+            statistic_ = compute_test_stat(estimate_, method, n_eff_, stat_adjust);
+            p_value_ = compute_p_value(estimate_, statistic_, method,
+                                       alternative, n_eff_, exact_null);
         }
     }
 
@@ -130,9 +463,7 @@ private:
     inline double compute_test_stat(double estimate,
                                     std::string method,
                                     double n_eff,
-                                    const std::vector<double>& x,
-                                    const std::vector<double>& y,
-                                    const std::vector<double>& weights)
+                                    double stat_adjust)
     {
         // prevent overflow in atanh
         if (estimate == 1.0)
@@ -144,13 +475,17 @@ private:
         if (methods::is_hoeffding(method)) {
             stat = estimate / 30.0 + 1.0 / (36.0 * n_eff);
         } else if (methods::is_kendall(method)) {
-            stat = estimate * impl::ktau_stat_adjust(x, y, weights);
+            stat = estimate * stat_adjust;
         } else if (methods::is_pearson(method)) {
             stat = std::atanh(estimate) * std::sqrt(n_eff - 3);
         } else if (methods::is_spearman(method)) {
             stat = std::atanh(estimate) * std::sqrt((n_eff - 3) / 1.06);
         }  else if (methods::is_blomqvist(method)) {
             stat = std::atanh(estimate) * std::sqrt(n_eff);
+        } else if (methods::is_distance(method)) {
+            stat = n_eff * estimate * estimate * stat_adjust;
+        } else if (methods::is_xi(method)) {
+            stat = estimate * std::sqrt(n_eff) * stat_adjust;
         } else {
             throw std::runtime_error("method not implemented.");
         }
@@ -158,11 +493,25 @@ private:
         return stat;
     }
 
-    inline double compute_p_value(double statistic,
+    //! computes the p-value; for unweighted samples without ties
+    //! (`exact_null`), small samples of Kendall's \f$ \tau \f$ and
+    //! Spearman's \f$ \rho \f$ use the exact null distribution.
+    inline double compute_p_value(double estimate,
+                                  double statistic,
                                   std::string method,
                                   std::string alternative,
-                                  double n_eff = 0.0)
+                                  double n_eff,
+                                  bool exact_null)
     {
+        // without weights, n_eff is the sample size
+        size_t n = static_cast<size_t>(n_eff);
+        if (exact_null && methods::is_kendall(method) &&
+            (n <= impl::ktau_exact_n_max))
+            return impl::pktau_exact(estimate, n, alternative);
+        if (exact_null && methods::is_spearman(method) &&
+            (n <= impl::srho_exact_n_max))
+            return impl::psrho_exact(estimate, n, alternative);
+
         double p_value;
         if (methods::is_hoeffding(method)) {
             if (n_eff == 0.0)
@@ -170,6 +519,12 @@ private:
             if (alternative != "two-sided")
                 throw std::runtime_error("only two-sided test available for Hoeffding's D.");
             p_value = impl::phoeffb(statistic, n_eff);
+        } else if (methods::is_distance(method)) {
+            if (alternative != "two-sided")
+                throw std::runtime_error("only two-sided test available for distance correlation.");
+            // conservative for small p-values (Szekely, Rizzo, and Bakirov,
+            // 2007, Theorem 6)
+            p_value = 2 * utils::normalCDF(-std::sqrt(statistic));
         } else {
             if (alternative == "two-sided") {
                 p_value = 2 * utils::normalCDF(-std::abs(statistic));
@@ -193,5 +548,83 @@ private:
     double p_value_;
 };
 
+//! calculates several (weighted) dependence measures and the corresponding
+//! independence tests at once.
+//!
+//! All measures are computed from a shared preprocessing of the data: missing
+//! values are handled once, each variable is sorted once, and the orderings
+//! and ranks are reused across measures.
+//!
+//! @param x, y input data.
+//! @param methods the dependence measures; see `Indep_test` for possible
+//!    values. By default, all available measures are computed.
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed; otherwise throws an error if `nan`s are present.
+//! @param alternative indicates the alternative hypothesis; see `Indep_test`.
+//!    Hoeffding's \f$ D \f$ only allows `"two-sided"`.
+//!
+//! @return a vector containing an `Indep_test` for each method.
+inline std::vector<Indep_test> wdm_all(
+    std::vector<double> x,
+    std::vector<double> y,
+    std::vector<std::string> methods = {"pearson", "spearman", "kendall",
+                                        "blomqvist", "hoeffding"},
+    std::vector<double> weights = std::vector<double>(),
+    bool remove_missing = true,
+    std::string alternative = "two-sided")
+{
+    utils::check_sizes(x, y, weights);
+    for (const auto& method : methods) {
+        if (!methods::is_hoeffding(method) && !methods::is_kendall(method) &&
+            !methods::is_pearson(method) && !methods::is_spearman(method) &&
+            !methods::is_blomqvist(method) && !methods::is_distance(method) &&
+            !methods::is_xi(method))
+            throw std::runtime_error("method not implemented.");
+    }
+
+    // na handling (per-method minimal sample sizes are checked below)
+    bool no_data =
+        (utils::preproc(x, y, weights, "pearson", remove_missing) == "return_nan");
+    double n_eff = utils::effective_sample_size(x.size(), weights);
+
+    std::vector<std::string> methods_ok;
+    for (const auto& method : methods) {
+        if (no_data)
+            continue;
+        if (x.size() >= methods::get_min_nobs(method)) {
+            methods_ok.push_back(method);
+        } else if (!remove_missing) {
+            std::stringstream msg;
+            msg << "need at least " << methods::get_min_nobs(method) <<
+                   " observations.";
+            throw std::runtime_error(msg.str());
+        }
+    }
+
+    bool exact_null = !no_data && impl::use_exact_null(x, y, weights);
+    double ktau_adjust = 0.0, dcor_adjust = 0.0, xi_adjust = 0.0;
+    std::vector<double> estimates;
+    if (methods_ok.size() > 0)
+        estimates = impl::wdm_all(x, y, methods_ok, weights, ktau_adjust,
+                                  dcor_adjust, xi_adjust);
+
+    std::vector<Indep_test> tests;
+    for (size_t k = 0, l = 0; k < methods.size(); k++) {
+        double estimate = std::numeric_limits<double>::quiet_NaN();
+        if ((l < methods_ok.size()) && (methods_ok[l] == methods[k]))
+            estimate = estimates[l++];
+        double stat_adjust = ktau_adjust;
+        if (methods::is_distance(methods[k]))
+            stat_adjust = dcor_adjust;
+        if (methods::is_xi(methods[k]))
+            stat_adjust = xi_adjust;
+        tests.push_back(Indep_test(methods[k], estimate, n_eff, stat_adjust,
+                                   alternative, exact_null));
+    }
+
+    return tests;
+}
+
 
 }
@@ -0,0 +1,152 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "utils.hpp"
+#include "ranks.hpp"
+#include "ktau.hpp"
+#include "hoeffd.hpp"
+#include "prho.hpp"
+#include "bbeta.hpp"
+#include "dcor.hpp"
+#include "xi.hpp"
+#include "methods.hpp"
+
+namespace wdm {
+
+namespace impl {
+
+//! calculates several (weighted) dependence measures from a single sort of
+//! each variable.
+//! @param x, y input data (without missing values).
+//! @param methods the dependence measures.
+//! @param weights an optional vector of weights for the data.
+//! @param ktau_adjust if Kendall's tau is among the methods, the tie
+//!   adjustment for its test statistic is stored here.
+//! @param dcor_adjust if the distance correlation is among the methods, the
+//!   adjustment for its test statistic is stored here.
+//! @param xi_adjust if Chatterjee's xi is among the methods, the adjustment
+//!   for its test statistic is stored here.
+//! @return a vector containing the dependence measures.
+inline std::vector<double> wdm_all(const std::vector<double>& x,
+                                   const std::vector<double>& y,
+                                   const std::vector<std::string>& methods,
+                                   const std::vector<double>& weights,
+                                   double& ktau_adjust,
+                                   double& dcor_adjust,
+                                   double& xi_adjust)
+{
+    WDM_PROFILE_SCOPE("wdm_all", x.size());
+    utils::check_sizes(x, y, weights);
+    bool need_rho = false, need_tau = false, need_d = false, need_dcor = false,
+        need_xi = false;
+    for (const auto& method : methods) {
+        need_rho = need_rho || methods::is_spearman(method);
+        need_tau = need_tau || methods::is_kendall(method);
+        need_d = need_d || methods::is_hoeffding(method);
+        need_dcor = need_dcor || methods::is_distance(method);
+        need_xi = need_xi || methods::is_xi(method);
+    }
+
+    // one sort per variable (breaking ties by the other one)
+    std::vector<size_t> order_x = utils::get_joint_order(x, y);
+    std::vector<size_t> order_y = utils::get_joint_order(y, x);
+    std::vector<double> w2;
+    if (need_d && (weights.size() > 0))
+        w2 = utils::pow(weights, 2);
+
+    double tau = 0.0, rho = 0.0, d = 0.0, dcor = 0.0, xi = 0.0;
+    if (need_tau) {
+        auto xs = utils::permute(x, order_x);
+        auto ys = utils::permute(y, order_x);
+        auto ws = utils::permute(weights, order_x);
+        auto ws_x = ws;
+        tau = ktau_sorted(xs, ys, ws);
+        ktau_adjust = ktau_stat_adjust_sorted(xs, ws_x,
+                                              utils::permute(y, order_y),
+                                              utils::permute(weights, order_y));
+    }
+
+    if (need_rho) {
+        rho = prho(rank0_from_order(x, order_x, weights, "average"),
+                   rank0_from_order(y, order_y, weights, "average"),
+                   weights);
+    }
+
+    if (need_d) {
+        // (weighted) ranks share the orderings from above
+        auto R_X = rank0_from_order(x, order_x, weights);
+        auto R_Y = rank0_from_order(y, order_y, weights);
+        auto S_X = R_X, S_Y = R_Y;
+        if (weights.size() > 0) {
+            S_X = rank0_from_order(x, order_x, w2);
+            S_Y = rank0_from_order(y, order_y, w2);
+        }
+        auto R_XY = bivariate_rank(x, y, weights);
+        auto S_XY = R_XY, T_XY = R_XY, U_XY = R_XY;
+        if (weights.size() > 0) {
+            S_XY = bivariate_rank(x, y, w2);
+            T_XY = bivariate_rank(x, y, utils::pow(weights, 3));
+            U_XY = bivariate_rank(x, y, utils::pow(weights, 4));
+        }
+        std::vector<double> sums;
+        if (weights.size() == 0) {
+            sums = utils::unit_power_sums(x.size(), 5);
+        } else {
+            sums = utils::power_sums(weights, 5);
+        }
+        d = hoeffd_from_ranks(R_X, R_Y, S_X, S_Y, R_XY, S_XY, T_XY, U_XY,
+                              weights, sums);
+    }
+
+    if (need_dcor) {
+        auto m_x = dcor_margin(x, weights, order_x);
+        auto m_y = dcor_margin(y, weights, order_y);
+        dcor = dcor_from_margins(m_x, m_y, weights);
+        dcor_adjust = dcor_stat_scale(m_x) * dcor_stat_scale(m_y);
+    }
+
+    if (need_xi) {
+        // ties in x are broken at random, so the joint order cannot be used
+        auto resp_y = xi_response(y, weights);
+        xi = xi_from_order(xi_order(x, random::make_key(xi_default_seeds())),
+                           resp_y, weights);
+        xi_adjust = 1.0 / resp_y.tau;
+    }
+
+    std::vector<double> estimates(methods.size());
+    for (size_t k = 0; k < methods.size(); k++) {
+        const auto& method = methods[k];
+        if (methods::is_hoeffding(method)) {
+            estimates[k] = d;
+        } else if (methods::is_kendall(method)) {
+            estimates[k] = tau;
+        } else if (methods::is_pearson(method)) {
+            estimates[k] = prho(x, y, weights);
+        } else if (methods::is_spearman(method)) {
+            estimates[k] = rho;
+        } else if (methods::is_blomqvist(method)) {
+            double med_x = median_sorted(utils::permute(x, order_x),
+                                         utils::permute(weights, order_x));
+            double med_y = median_sorted(utils::permute(y, order_y),
+                                         utils::permute(weights, order_y));
+            estimates[k] = bbeta_from_medians(x, y, weights, med_x, med_y);
+        } else if (methods::is_distance(method)) {
+            estimates[k] = dcor;
+        } else if (methods::is_xi(method)) {
+            estimates[k] = xi;
+        } else {
+            throw std::runtime_error("method not implemented.");
+        }
+    }
+
+    return estimates;
+}
+
+}
+
+}
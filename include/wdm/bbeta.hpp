@@ -7,11 +7,55 @@
 #pragma once
 
 #include "utils.hpp"
+#include "ranks.hpp"
 
 namespace wdm {
     
 namespace impl {
 
+//! calculates the weighted Blomqvists's beta given the medians of the data.
+//! @tparam W the weight policy (see `utils::Weighted`).
+//! @param x, y input data.
+//! @param weights pointer to the weights; only read if `W` is
+//!   `utils::Weighted`.
+//! @param med_x, med_y the (weighted) medians of `x` and `y`.
+template<class W>
+double bbeta_from_medians(const std::vector<double>& x,
+                          const std::vector<double>& y,
+                          const double* weights,
+                          double med_x,
+                          double med_y)
+{
+    // count elements in lower left and upper right quadrants
+    double w_acc{0.0}, w_sum{0.0};
+    for (size_t i = 0; i < x.size(); i++) {
+        double w = W::get(weights, i);
+        if ((x[i] <= med_x) && (y[i] <= med_y))
+            w_acc += w;
+        else if ((x[i] > med_x) && (y[i] > med_y))
+            w_acc += w;
+        w_sum += w;
+    }
+
+    return 2 * w_acc / w_sum - 1;
+}
+
+//! calculates the weighted Blomqvists's beta given the medians of the data.
+//! @param x, y input data.
+//! @param weights vector of weights for the data; can be empty.
+//! @param med_x, med_y the (weighted) medians of `x` and `y`.
+inline double bbeta_from_medians(const std::vector<double>& x,
+                                 const std::vector<double>& y,
+                                 const std::vector<double>& weights,
+                                 double med_x,
+                                 double med_y)
+{
+    if (weights.size() > 0)
+        return bbeta_from_medians<utils::Weighted>(x, y, weights.data(),
+                                                   med_x, med_y);
+    return bbeta_from_medians<utils::Unweighted>(x, y, nullptr, med_x, med_y);
+}
+
 //! calculates the weighted Blomqvists's beta.
 //! @param x, y input data.
 //! @param weights an optional vector of weights for the data.
@@ -19,26 +63,14 @@ inline double bbeta(const std::vector<double>& x,
                     const std::vector<double>& y,
                     std::vector<double> weights = std::vector<double>())
 {
+    WDM_PROFILE_SCOPE("bbeta", x.size());
     utils::check_sizes(x, y, weights);
-    size_t n = x.size();
 
     // find the medians
     double med_x = impl::median(x, weights);
     double med_y = impl::median(y, weights);
 
-    if (weights.size() == 0)
-        weights = std::vector<double>(n, 1.0);
-
-    // count elements in lower left and upper right quadrants
-    double w_acc{0.0};
-    for (size_t i = 0; i < n; i++) {
-        if ((x[i] <= med_x) && (y[i] <= med_y))
-            w_acc += weights[i];
-        else if ((x[i] > med_x) && (y[i] > med_y))
-            w_acc += weights[i];
-    }
-
-    return 2 * w_acc / utils::sum(weights) - 1;
+    return bbeta_from_medians(x, y, weights, med_x, med_y);
 }
 
 }
@@ -0,0 +1,471 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "tiled.hpp"
+
+#if defined(_WIN32)
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace wdm {
+
+namespace impl {
+
+//! header of the columnar file format.
+const char columnar_magic[8] = {'W', 'D', 'M', 'C', 'O', 'L', 'S', '1'};
+const size_t columnar_header_size = 64;
+
+//! fields of the header following the magic number.
+struct Columnar_header {
+    uint64_t n;
+    uint64_t d;
+    uint64_t validity;
+};
+
+//! the number of 64-bit words of a validity bitmap.
+inline size_t validity_words(size_t n)
+{
+    return (n + 63) / 64;
+}
+
+//! a read-only memory mapping of a file.
+class File_mapping {
+public:
+    //! @param path the file.
+    explicit File_mapping(const std::string& path) : data_(nullptr), size_(0)
+    {
+#if defined(_WIN32)
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+        if (file_ == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("cannot open '" + path + "'.");
+        LARGE_INTEGER size;
+        mapping_ = nullptr;
+        if (GetFileSizeEx(file_, &size) && (size.QuadPart > 0)) {
+            size_ = static_cast<size_t>(size.QuadPart);
+            mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY,
+                                          0, 0, nullptr);
+            if (mapping_)
+                data_ = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+        }
+        if (!data_) {
+            close();
+            throw std::runtime_error("cannot map '" + path + "'.");
+        }
+#else
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0)
+            throw std::runtime_error("cannot open '" + path + "'.");
+        struct stat st;
+        if ((::fstat(fd_, &st) == 0) && (st.st_size > 0)) {
+            size_ = static_cast<size_t>(st.st_size);
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+            if (p != MAP_FAILED)
+                data_ = p;
+        }
+        if (!data_) {
+            close();
+            throw std::runtime_error("cannot map '" + path + "'.");
+        }
+#endif
+    }
+
+    ~File_mapping() { close(); }
+
+    File_mapping(const File_mapping&) = delete;
+    File_mapping& operator=(const File_mapping&) = delete;
+
+    const char* data() const { return static_cast<const char*>(data_); }
+    size_t size() const { return size_; }
+
+private:
+    void close()
+    {
+#if defined(_WIN32)
+        if (data_)
+            UnmapViewOfFile(data_);
+        if (mapping_)
+            CloseHandle(mapping_);
+        CloseHandle(file_);
+#else
+        if (data_)
+            ::munmap(data_, size_);
+        ::close(fd_);
+#endif
+        data_ = nullptr;
+    }
+
+#if defined(_WIN32)
+    HANDLE file_;
+    HANDLE mapping_;
+#else
+    int fd_;
+#endif
+    void* data_;
+    size_t size_;
+};
+
+}
+
+//! read-only access to a data set stored in the columnar file format.
+//!
+//! The file starts with a header of 64 bytes: the magic number `WDMCOLS1`
+//! followed by the number of observations `n`, the number of variables `d`,
+//! and a flag indicating validity bitmaps (each as `uint64_t`). The columns
+//! follow as contiguous blocks of `n` doubles. If the flag is set, each
+//! column's block is followed (after all columns) by a bitmap of
+//! `ceil(n / 64)` words of 64 bits, where bit `i % 64` of word `i / 64` is set
+//! if observation `i` is present; absent observations are treated as `nan`.
+//! All values are in native byte order. Files are written by
+//! `write_columnar()`.
+//!
+//! The file is memory-mapped, so columns are read directly from the page
+//! cache and the data never has to fit into memory at once.
+class Columnar_file {
+public:
+    //! @param path the file.
+    explicit Columnar_file(std::string path) : map_(path)
+    {
+        if ((map_.size() < impl::columnar_header_size) ||
+            (std::memcmp(map_.data(), impl::columnar_magic,
+                         sizeof(impl::columnar_magic)) != 0))
+            throw std::runtime_error("'" + path + "' is not a columnar file.");
+        impl::Columnar_header header;
+        std::memcpy(&header, map_.data() + sizeof(impl::columnar_magic),
+                    sizeof(header));
+        n_ = header.n;
+        d_ = header.d;
+        validity_ = (header.validity != 0);
+        size_t size = impl::columnar_header_size + n_ * d_ * sizeof(double);
+        if (validity_)
+            size += d_ * impl::validity_words(n_) * sizeof(uint64_t);
+        if (map_.size() < size)
+            throw std::runtime_error("'" + path + "' is truncated.");
+    }
+
+    //! the number of observations.
+    size_t n() const { return n_; }
+
+    //! the number of variables.
+    size_t d() const { return d_; }
+
+    //! whether the file contains validity bitmaps.
+    bool has_validity() const { return validity_; }
+
+    //! pointer to the values of column `j` in the mapping; entries that are
+    //! not valid must be ignored (see `is_valid()`).
+    const double* data(size_t j) const
+    {
+        return reinterpret_cast<const double*>(
+            map_.data() + impl::columnar_header_size + j * n_ * sizeof(double));
+    }
+
+    //! pointer to the validity bitmap of column `j`; `nullptr` if there is
+    //! none.
+    const uint64_t* validity(size_t j) const
+    {
+        if (!validity_)
+            return nullptr;
+        size_t words = impl::validity_words(n_);
+        return reinterpret_cast<const uint64_t*>(
+            map_.data() + impl::columnar_header_size +
+            d_ * n_ * sizeof(double) + j * words * sizeof(uint64_t));
+    }
+
+    //! whether observation `i` of column `j` is present.
+    bool is_valid(size_t i, size_t j) const
+    {
+        return !validity_ || ((validity(j)[i / 64] >> (i % 64)) & 1);
+    }
+
+    //! whether column `j` contains neither invalid entries nor `nan`s.
+    bool is_complete(size_t j) const
+    {
+        if (validity_) {
+            const uint64_t* bits = validity(j);
+            for (size_t k = 0; k < n_ / 64; k++) {
+                if (~bits[k] != 0)
+                    return false;
+            }
+            uint64_t mask = (uint64_t(1) << (n_ % 64)) - 1;
+            if ((n_ % 64 > 0) && ((bits[n_ / 64] & mask) != mask))
+                return false;
+        }
+        const double* x = data(j);
+        for (size_t i = 0; i < n_; i++) {
+            if (std::isnan(x[i]))
+                return false;
+        }
+        return true;
+    }
+
+    //! copies column `j` into a vector; invalid entries are set to `nan`.
+    std::vector<double> column(size_t j) const
+    {
+        const double* x = data(j);
+        std::vector<double> col(x, x + n_);
+        if (validity_) {
+            for (size_t i = 0; i < n_; i++) {
+                if (!is_valid(i, j))
+                    col[i] = std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+        return col;
+    }
+
+private:
+    impl::File_mapping map_;
+    size_t n_;
+    size_t d_;
+    bool validity_;
+};
+
+namespace impl {
+
+//! writes a data set in the columnar file format.
+//! @param column the input columns.
+//! @param n, d number of observations and variables.
+//! @param path the output file.
+//! @param validity whether validity bitmaps marking the `nan`s are written.
+inline void write_columnar(const Column_source& column,
+                           size_t n,
+                           size_t d,
+                           std::string path,
+                           bool validity)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("cannot open '" + path + "' for writing.");
+    Columnar_header header{n, d, validity};
+    char buf[columnar_header_size] = {};
+    std::memcpy(buf, columnar_magic, sizeof(columnar_magic));
+    std::memcpy(buf + sizeof(columnar_magic), &header, sizeof(header));
+    file.write(buf, columnar_header_size);
+
+    std::vector<uint64_t> bits;
+    if (validity)
+        bits.assign(d * validity_words(n), 0);
+    for (size_t j = 0; j < d; j++) {
+        auto col = column(j);
+        if (col.size() != n)
+            throw std::runtime_error("all columns must have size n.");
+        file.write(reinterpret_cast<const char*>(col.data()),
+                   n * sizeof(double));
+        for (size_t i = 0; validity && (i < n); i++) {
+            if (!std::isnan(col[i]))
+                bits[j * validity_words(n) + i / 64] |= uint64_t(1) << (i % 64);
+        }
+    }
+    file.write(reinterpret_cast<const char*>(bits.data()),
+               bits.size() * sizeof(uint64_t));
+    if (!file)
+        throw std::runtime_error("writing to '" + path + "' failed.");
+}
+
+//! calculates dependence measures between columns of two columnar files.
+//!
+//! Pearson correlations of complete columns are computed directly on the
+//! mapping; for all other pairs, the two columns are copied for the duration
+//! of the computation.
+//! @param x, y the data sets.
+//! @param pairs the pairs of columns `(i, j)` of `x` and `y`.
+//! @param method the dependence measure.
+//! @param weights vector of weights for the data; can be empty.
+//! @param remove_missing see `wdm()`.
+//! @param num_threads number of threads.
+inline std::vector<double> wdm_columnar(
+    const Columnar_file& x,
+    const Columnar_file& y,
+    const std::vector<std::pair<size_t, size_t>>& pairs,
+    std::string method,
+    const std::vector<double>& weights,
+    bool remove_missing,
+    size_t num_threads)
+{
+    size_t n = x.n();
+    if (y.n() != n)
+        throw std::runtime_error("x and y must have the same number of rows.");
+    if ((weights.size() > 0) && (weights.size() != n))
+        throw std::runtime_error("weights and data must have same size.");
+
+    bool direct = methods::is_pearson(method) && !utils::any_nan(weights) &&
+        (n >= methods::get_min_nobs(method));
+    std::vector<char> complete_x, complete_y;
+    if (direct) {
+        complete_x.resize(x.d());
+        complete_y.resize(y.d());
+        utils::parallel_for(x.d(), num_threads, [&] (size_t j, size_t) {
+            complete_x[j] = x.is_complete(j);
+        });
+        utils::parallel_for(y.d(), num_threads, [&] (size_t j, size_t) {
+            complete_y[j] = (&x == &y) ? complete_x[j] : y.is_complete(j);
+        });
+    }
+
+    std::vector<double> res(pairs.size());
+    const double* w = (weights.size() > 0) ? weights.data() : nullptr;
+    utils::parallel_for(pairs.size(), num_threads, [&] (size_t k, size_t) {
+        size_t i = pairs[k].first, j = pairs[k].second;
+        if (direct && complete_x[i] && complete_y[j]) {
+            res[k] = prho_raw(x.data(i), y.data(j), w, n);
+        } else {
+            res[k] = wdm(x.column(i), y.column(j), method, weights,
+                         remove_missing);
+        }
+    });
+
+    return res;
+}
+
+}
+
+//! writes a data set in the columnar file format (see `Columnar_file`).
+//! @param x input data.
+//! @param path the output file; overwritten if it exists.
+//! @param validity whether validity bitmaps marking the `nan`s are written;
+//!    `nan`s are stored as values in either case.
+inline void write_columnar(const Eigen::MatrixXd& x,
+                           std::string path,
+                           bool validity = false)
+{
+    impl::write_columnar(
+        [&x] (size_t j) { return utils::convert_vec(x.col(j)); },
+        x.rows(), x.cols(), path, validity);
+}
+
+//! calculates a matrix of (weighted) dependence measures for a data set in
+//! the columnar file format.
+//!
+//! Columns are read from the memory mapping as they are needed, so that the
+//! data is never copied into a dense matrix.
+//! @param x input data.
+//! @param method the dependence measure; see `wdm()` for possible values.
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing if `true`, all observations containing a `nan` (or
+//!    an invalid entry) are removed (separately for each pair); otherwise
+//!    throws an error if `nan`s are present.
+//! @param num_threads number of threads; `0` (default) uses all available
+//!    cores.
+//! @details
+//! For measures that are not symmetric (Chatterjee's \f$ \xi \f$), the
+//! entry `(i, j)` is the measure with column `i` as first and column `j` as
+//! second argument.
+//!
+//! @return a matrix of pairwise dependence measures.
+inline Eigen::MatrixXd wdm(const Columnar_file& x,
+                           std::string method,
+                           Eigen::VectorXd weights = Eigen::VectorXd(),
+                           bool remove_missing = true,
+                           size_t num_threads = 0)
+{
+    WDM_PROFILE_SCOPE("matrix", x.n() * x.d());
+    size_t d = x.d();
+    if (d < 2)
+        throw std::runtime_error("x must have at least 2 columns.");
+
+    bool symmetric = methods::is_symmetric(method);
+    std::vector<std::pair<size_t, size_t>> pairs;
+    for (size_t i = 0; i < d; i++) {
+        for (size_t j = symmetric ? i + 1 : 0; j < d; j++) {
+            if (j != i)
+                pairs.push_back(std::make_pair(i, j));
+        }
+    }
+    auto res = impl::wdm_columnar(x, x, pairs, method,
+                                  utils::convert_vec(weights), remove_missing,
+                                  num_threads);
+
+    Eigen::MatrixXd ms = Eigen::MatrixXd::Identity(d, d);
+    for (size_t k = 0; k < pairs.size(); k++) {
+        ms(pairs[k].first, pairs[k].second) = res[k];
+        if (symmetric)
+            ms(pairs[k].second, pairs[k].first) = res[k];
+    }
+    return ms;
+}
+
+//! calculates (weighted) dependence measures between all columns of two
+//! data sets in the columnar file format.
+//! @param x, y input data with the same number of observations.
+//! @param method the dependence measure; see `wdm()` for possible values.
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing if `true`, all observations containing a `nan` (or
+//!    an invalid entry) are removed (separately for each pair); otherwise
+//!    throws an error if `nan`s are present.
+//! @param num_threads number of threads; `0` (default) uses all available
+//!    cores.
+//!
+//! @return a matrix whose entry `(i, j)` is the measure with column `i` of
+//!    `x` as first and column `j` of `y` as second argument.
+inline Eigen::MatrixXd wdm(const Columnar_file& x,
+                           const Columnar_file& y,
+                           std::string method,
+                           Eigen::VectorXd weights = Eigen::VectorXd(),
+                           bool remove_missing = true,
+                           size_t num_threads = 0)
+{
+    WDM_PROFILE_SCOPE("matrix", x.n() * (x.d() + y.d()));
+    std::vector<std::pair<size_t, size_t>> pairs;
+    for (size_t i = 0; i < x.d(); i++) {
+        for (size_t j = 0; j < y.d(); j++)
+            pairs.push_back(std::make_pair(i, j));
+    }
+    auto res = impl::wdm_columnar(x, y, pairs, method,
+                                  utils::convert_vec(weights), remove_missing,
+                                  num_threads);
+
+    Eigen::MatrixXd ms(x.d(), y.d());
+    for (size_t k = 0; k < pairs.size(); k++)
+        ms(pairs[k].first, pairs[k].second) = res[k];
+    return ms;
+}
+
+//! calculates a matrix of (weighted) dependence measures for a data set in
+//! the columnar file format tile by tile; see the matrix version of
+//! `wdm_tiled()`.
+inline void wdm_tiled(const Columnar_file& x,
+                      std::string method,
+                      const std::function<void(const Matrix_tile&)>& sink,
+                      Eigen::VectorXd weights = Eigen::VectorXd(),
+                      bool remove_missing = true,
+                      size_t tile_size = 512,
+                      size_t num_threads = 0)
+{
+    impl::wdm_tiles([&x] (size_t j) { return x.column(j); },
+                    x.n(), x.d(), method, utils::convert_vec(weights),
+                    remove_missing, tile_size, num_threads, sink);
+}
+
+//! calculates a matrix of (weighted) dependence measures for a data set in
+//! the columnar file format and writes it tile by tile to a binary file; see
+//! the file version of `wdm_tiled()`.
+inline void wdm_tiled(const Columnar_file& x,
+                      std::string method,
+                      std::string path,
+                      Eigen::VectorXd weights = Eigen::VectorXd(),
+                      bool remove_missing = true,
+                      bool single_precision = false,
+                      size_t tile_size = 512,
+                      size_t num_threads = 0)
+{
+    impl::write_tiles([&x] (size_t j) { return x.column(j); },
+                      x.n(), x.d(), method, utils::convert_vec(weights),
+                      remove_missing, tile_size, num_threads, path,
+                      single_precision);
+}
+
+}
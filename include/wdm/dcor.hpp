@@ -0,0 +1,194 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "utils.hpp"
+#include <cmath>
+
+namespace wdm {
+
+namespace impl {
+
+//! marginal quantities of a variable entering the distance correlation.
+struct Dcor_margin {
+    std::vector<double> x;      //!< the standardized data.
+    std::vector<size_t> order;  //!< a permutation bringing `x` in ascending order.
+    std::vector<size_t> ranks;  //!< dense ranks of `x` (starting at 1).
+    std::vector<double> a;      //!< mean distance of each observation to all others.
+    double a_mean;              //!< the grand mean distance.
+    double dvar;                //!< the squared distance variance.
+};
+
+//! computes the marginal quantities of a variable entering the (weighted)
+//! distance correlation.
+//! @param x input data.
+//! @param weights vector of weights for the data; can be empty.
+//! @param order a permutation bringing `x` in ascending order.
+inline Dcor_margin dcor_margin(const std::vector<double>& x,
+                               const std::vector<double>& weights,
+                               std::vector<size_t> order)
+{
+    size_t n = x.size();
+    auto weight = [&weights] (size_t i) {
+        return (weights.size() > 0) ? weights[i] : 1.0;
+    };
+
+    // distance correlation is invariant to location and scale; standardizing
+    // first keeps the sums below well conditioned
+    double w_sum = 0.0, mean = 0.0, var = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        w_sum += weight(i);
+        mean += weight(i) * x[i];
+    }
+    mean /= w_sum;
+    for (size_t i = 0; i < n; i++)
+        var += weight(i) * (x[i] - mean) * (x[i] - mean);
+    var /= w_sum;
+
+    Dcor_margin m;
+    m.x = std::vector<double>(n, 0.0);
+    if (var > 0.0) {
+        for (size_t i = 0; i < n; i++)
+            m.x[i] = (x[i] - mean) / std::sqrt(var);
+    }
+    m.ranks = utils::dense_ranks(x, order);
+    m.order = std::move(order);
+
+    // mean distances from cumulative sums in sorted order; tied observations
+    // do not contribute to the distances
+    double s_sum = 0.0;
+    for (size_t i = 0; i < n; i++)
+        s_sum += weight(i) * m.x[i];
+    m.a.resize(n);
+    double w_le = 0.0, s_le = 0.0;
+    for (size_t k = 0; k < n; k++) {
+        size_t i = m.order[k];
+        w_le += weight(i);
+        s_le += weight(i) * m.x[i];
+        m.a[i] = m.x[i] * w_le - s_le + (s_sum - s_le) - m.x[i] * (w_sum - w_le);
+        m.a[i] /= w_sum;
+    }
+
+    // the mean squared distance is twice the variance
+    double a_sq = 0.0;
+    m.a_mean = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        m.a_mean += weight(i) * m.a[i];
+        a_sq += weight(i) * m.a[i] * m.a[i];
+    }
+    m.a_mean /= w_sum;
+    m.dvar = ((var > 0.0) ? 2.0 : 0.0) + m.a_mean * m.a_mean - 2 * a_sq / w_sum;
+
+    return m;
+}
+
+//! calculates the squared (weighted) distance covariance (V-statistic) from
+//! the marginal quantities of two variables.
+//!
+//! The mean of \f$ |x_i - x_j| |y_i - y_j| \f$ over all pairs is computed in
+//! \f$ O(n \log n) \f$: observations are processed in x order and sums of
+//! \f$ w, wx, wy, wxy \f$ over previous observations with smaller (larger) y
+//! are kept in a Fenwick tree indexed by the ranks of y (Huo and Szekely,
+//! 2016).
+//! @param mx, my the marginal quantities (see `dcor_margin()`).
+//! @param weights vector of weights for the data; can be empty.
+inline double dcov2_from_margins(const Dcor_margin& mx,
+                                 const Dcor_margin& my,
+                                 const std::vector<double>& weights)
+{
+    size_t n = mx.x.size();
+    size_t max_rank = (n > 0) ? my.ranks[my.order[n - 1]] : 0;
+    utils::Fenwick_tree tree(max_rank, 4);
+    std::vector<double> tied(4 * (max_rank + 1), 0.0);
+    double total[4] = {0.0, 0.0, 0.0, 0.0}, below[4], above[4];
+    double w_sum = 0.0, s_xy = 0.0, s_ab = 0.0;
+    for (size_t k = 0; k < n; k++) {
+        size_t i = mx.order[k], r = my.ranks[i];
+        double w = (weights.size() > 0) ? weights[i] : 1.0;
+        double x = mx.x[i], y = my.x[i];
+
+        // previous observations have x_j <= x_i, so that
+        // |x_i - x_j| |y_i - y_j| = +-(x_i - x_j) (y_i - y_j)
+        tree.prefix_sum(r - 1, below);
+        for (size_t l = 0; l < 4; l++)
+            above[l] = total[l] - below[l] - tied[4 * r + l];
+        s_xy += w * (x * y * (below[0] - above[0]) - x * (below[2] - above[2]) -
+                     y * (below[1] - above[1]) + (below[3] - above[3]));
+
+        double values[4] = {w, w * x, w * y, w * x * y};
+        tree.add(r, values);
+        for (size_t l = 0; l < 4; l++) {
+            total[l] += values[l];
+            tied[4 * r + l] += values[l];
+        }
+        w_sum += w;
+        s_ab += w * mx.a[i] * my.a[i];
+    }
+
+    return 2 * s_xy / (w_sum * w_sum) + mx.a_mean * my.a_mean - 2 * s_ab / w_sum;
+}
+
+//! calculates the (weighted) distance correlation from the marginal
+//! quantities of two variables.
+//! @param mx, my the marginal quantities (see `dcor_margin()`).
+//! @param weights vector of weights for the data; can be empty.
+inline double dcor_from_margins(const Dcor_margin& mx,
+                                const Dcor_margin& my,
+                                const std::vector<double>& weights)
+{
+    double r2 = dcov2_from_margins(mx, my, weights) / std::sqrt(mx.dvar * my.dvar);
+    return std::sqrt(std::min(std::max(r2, 0.0), 1.0));
+}
+
+//! the contribution of a variable to the adjustment of the test statistic of
+//! the distance correlation (see `dcor_stat_adjust()`).
+//! @param m the marginal quantities (see `dcor_margin()`).
+inline double dcor_stat_scale(const Dcor_margin& m)
+{
+    return std::sqrt(m.dvar) / m.a_mean;
+}
+
+//! fast calculation of the (weighted) distance correlation.
+//! @param x, y input data.
+//! @param weights an optional vector of weights for the data.
+//! @details
+//! The squared distance covariance is computed as a V-statistic with the
+//! algorithm of Huo and Szekely (2016) in \f$ O(n \log n) \f$ time; the
+//! result is the square root of the squared distance correlation, i.e.,
+//! it lies in \f$ [0, 1] \f$.
+inline double dcor(const std::vector<double>& x,
+                   const std::vector<double>& y,
+                   const std::vector<double>& weights = std::vector<double>())
+{
+    WDM_PROFILE_SCOPE("dcor", x.size());
+    utils::check_sizes(x, y, weights);
+    auto mx = dcor_margin(x, weights, utils::get_order(x));
+    auto my = dcor_margin(y, weights, utils::get_order(y));
+    return dcor_from_margins(mx, my, weights);
+}
+
+//! calculates the adjustment for the test statistic of the distance
+//! correlation.
+//!
+//! The statistic \f$ n V_n^2 / S_2 \f$ of Szekely, Rizzo, and Bakirov (2007)
+//! equals \f$ n R_n^2 \f$ times the returned value, where \f$ R_n \f$ is the
+//! distance correlation.
+//! @param x, y input data.
+//! @param weights an optional vector of weights for the data.
+inline double dcor_stat_adjust(const std::vector<double>& x,
+                               const std::vector<double>& y,
+                               const std::vector<double>& weights = std::vector<double>())
+{
+    utils::check_sizes(x, y, weights);
+    auto mx = dcor_margin(x, weights, utils::get_order(x));
+    auto my = dcor_margin(y, weights, utils::get_order(y));
+    return dcor_stat_scale(mx) * dcor_stat_scale(my);
+}
+
+}
+
+}
@@ -8,6 +8,7 @@
 
 #include <Eigen/Dense>
 #include "../wdm.hpp"
+#include <utility>
 
 
 namespace wdm {
@@ -36,6 +37,8 @@ namespace utils {
 //!   - `"kendall"`, `"ktau"`, `"tau"`: Kendall's \f$ \tau \f$  
 //!   - `"blomqvist"`, `"bbeta"`, `"beta"`: Blomqvist's \f$ \beta \f$  
 //!   - `"hoeffding"`, `"hoeffd"`, `"d"`: Hoeffding's \f$ D \f$  
+//!   - `"distance"`, `"dcor"`: distance correlation  
+//!   - `"xi"`, `"chatterjee"`: Chatterjee's \f$ \xi \f$  
 //! 
 //! @return the dependence measure
 inline double wdm(const Eigen::VectorXd& x,
@@ -51,6 +54,32 @@ inline double wdm(const Eigen::VectorXd& x,
                remove_missing);
 }
 
+//! calculates a (weighted) dependence measure for many weight vectors.
+//! @param x, y input data.
+//! @param method the dependence measure; see `wdm()` for possible values.
+//! @param weights a matrix whose columns are the weight vectors.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed; otherwise throws an error if `nan`s are present.
+//!
+//! @return a vector containing the dependence measure for each column of
+//!    `weights`.
+inline Eigen::VectorXd wdm_multi(const Eigen::VectorXd& x,
+                                 const Eigen::VectorXd& y,
+                                 std::string method,
+                                 const Eigen::MatrixXd& weights,
+                                 bool remove_missing = true)
+{
+    std::vector<std::vector<double>> w(weights.cols());
+    for (size_t l = 0; l < w.size(); l++)
+        w[l] = utils::convert_vec(weights.col(l));
+    auto res = wdm_multi(utils::convert_vec(x),
+                         utils::convert_vec(y),
+                         method,
+                         w,
+                         remove_missing);
+    return Eigen::Map<Eigen::VectorXd>(res.data(), res.size());
+}
+
 //! calculates a matrix of (weighted) dependence measures.
 //! @param x input data.
 //! @param method the dependence measure; see details for possible values. 
@@ -64,18 +93,67 @@ inline double wdm(const Eigen::VectorXd& x,
 //!   - `"kendall"`, `"ktau"`, `"tau"`: Kendall's \f$ \tau \f$  
 //!   - `"blomqvist"`, `"bbeta"`, `"beta"`: Blomqvist's \f$ \beta \f$  
 //!   - `"hoeffding"`, `"hoeffd"`, `"d"`: Hoeffding's \f$ D \f$  
+//!   - `"distance"`, `"dcor"`: distance correlation  
+//!   - `"xi"`, `"chatterjee"`: Chatterjee's \f$ \xi \f$  
 //! 
+//! For measures that are not symmetric (Chatterjee's \f$ \xi \f$), the
+//! entry `(i, j)` is the measure with `x.col(i)` as first and `x.col(j)` as
+//! second argument.
+//!
 //! @return a matrix of pairwise dependence measures.
 inline Eigen::MatrixXd wdm(const Eigen::MatrixXd& x,
                            std::string method,
                            Eigen::VectorXd weights = Eigen::VectorXd(),
                            bool remove_missing = true)
 {
+    WDM_PROFILE_SCOPE("matrix", x.size());
     size_t d = x.cols();
     if (d == 1)
         throw std::runtime_error("x must have at least 2 columns.");
     
     Eigen::MatrixXd ms = Eigen::MatrixXd::Identity(d, d);
+    if (methods::is_distance(method) && !x.hasNaN() && !weights.hasNaN() &&
+        (static_cast<size_t>(x.rows()) >= methods::get_min_nobs(method))) {
+        // the marginal quantities are computed once for each variable
+        if ((weights.size() > 0) && (weights.size() != x.rows()))
+            throw std::runtime_error("weights and data must have same size.");
+        auto w = utils::convert_vec(weights);
+        std::vector<impl::Dcor_margin> margins(d);
+        for (size_t j = 0; j < d; j++) {
+            auto col = utils::convert_vec(x.col(j));
+            margins[j] = impl::dcor_margin(col, w, utils::get_order(col));
+        }
+        for (size_t i = 0; i < d; i++) {
+            for (size_t j = i + 1; j < d; j++) {
+                ms(i, j) = impl::dcor_from_margins(margins[i], margins[j], w);
+                ms(j, i) = ms(i, j);
+            }
+        }
+        return ms;
+    }
+    if (methods::is_xi(method) && !x.hasNaN() && !weights.hasNaN() &&
+        (static_cast<size_t>(x.rows()) >= methods::get_min_nobs(method))) {
+        // each variable is sorted once as predictor and once as response
+        if ((weights.size() > 0) && (weights.size() != x.rows()))
+            throw std::runtime_error("weights and data must have same size.");
+        auto w = utils::convert_vec(weights);
+        auto key = random::make_key(impl::xi_default_seeds());
+        std::vector<std::vector<size_t>> orders(d);
+        std::vector<impl::Xi_response> responses(d);
+        for (size_t j = 0; j < d; j++) {
+            auto col = utils::convert_vec(x.col(j));
+            orders[j] = impl::xi_order(col, key);
+            responses[j] = impl::xi_response(col, w);
+        }
+        for (size_t i = 0; i < d; i++) {
+            for (size_t j = 0; j < d; j++) {
+                if (j != i)
+                    ms(i, j) = impl::xi_from_order(orders[i], responses[j], w);
+            }
+        }
+        return ms;
+    }
+
     for (size_t i = 0; i < d; i++) {
         for (size_t j = i + 1; j < d; j++) {
             ms(i, j) = wdm(utils::convert_vec(x.col(i)),
@@ -83,11 +161,248 @@ inline Eigen::MatrixXd wdm(const Eigen::MatrixXd& x,
                            method,
                            utils::convert_vec(weights),
                            remove_missing);
-            ms(j, i) = ms(i, j);
+            if (methods::is_symmetric(method)) {
+                ms(j, i) = ms(i, j);
+            } else {
+                ms(j, i) = wdm(utils::convert_vec(x.col(j)),
+                               utils::convert_vec(x.col(i)),
+                               method,
+                               utils::convert_vec(weights),
+                               remove_missing);
+            }
         }
     }
 
     return ms;
 }
 
+
+
+//! matrices of (weighted) dependence measures and the corresponding
+//! independence tests for all pairs of variables.
+struct Indep_test_matrix {
+    Eigen::MatrixXd estimate;   //!< the estimated dependence measures.
+    Eigen::MatrixXd statistic;  //!< the test statistics.
+    Eigen::MatrixXd p_value;    //!< the (adjusted) p-values.
+};
+
+//! performs independence tests for all pairs of variables in parallel.
+//! @param x input data.
+//! @param method the dependence measure; see `Indep_test` for possible
+//!    values.
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed (separately for each pair); otherwise throws an error if `nan`s
+//!    are present.
+//! @param alternative indicates the alternative hypothesis; see
+//!    `Indep_test`.
+//! @param p_adjust adjustment of the p-values for multiple testing across
+//!    all pairs: `"none"` (default), `"holm"`, or `"BH"`
+//!    (Benjamini-Hochberg).
+//! @param num_threads number of threads; `0` (default) uses all available
+//!    cores.
+//! @details
+//! Without missing values, the effective sample size and the marginal
+//! quantities of each variable (tie profiles for Kendall's \f$ \tau \f$,
+//! mean distances for the distance correlation, orderings and ranks for
+//! Chatterjee's \f$ \xi \f$) are computed once and shared across all pairs.
+//! For measures that are not symmetric, the entry `(i, j)` refers to the
+//! test with `x.col(i)` as first and `x.col(j)` as second argument and all
+//! ordered pairs are tested. The diagonal contains an estimate of one and
+//! missing statistics and p-values.
+//!
+//! @return the matrices of estimates, statistics, and p-values.
+inline Indep_test_matrix indep_test_matrix(const Eigen::MatrixXd& x,
+                                           std::string method,
+                                           Eigen::VectorXd weights = Eigen::VectorXd(),
+                                           bool remove_missing = true,
+                                           std::string alternative = "two-sided",
+                                           std::string p_adjust = "none",
+                                           size_t num_threads = 0)
+{
+    WDM_PROFILE_SCOPE("matrix", x.size());
+    size_t n = x.rows(), d = x.cols();
+    if (d < 2)
+        throw std::runtime_error("x must have at least 2 columns.");
+    if ((weights.size() > 0) && (static_cast<size_t>(weights.size()) != n))
+        throw std::runtime_error("weights and data must have same size.");
+    utils::p_adjust(std::vector<double>(), p_adjust);  // validates p_adjust
+
+    auto w = utils::convert_vec(weights);
+    std::vector<std::vector<double>> cols(d);
+    for (size_t j = 0; j < d; j++)
+        cols[j] = utils::convert_vec(x.col(j));
+
+    // without missing values, all pairs share the same sample
+    bool shared = !x.hasNaN() && !weights.hasNaN() &&
+        (n >= methods::get_min_nobs(method));
+    double n_eff = utils::effective_sample_size(n, w);
+    std::vector<impl::Tie_profile> ties;
+    std::vector<double> sums;
+    if (shared && methods::is_kendall(method)) {
+        ties.resize(d);
+        utils::parallel_for(d, num_threads, [&] (size_t j, size_t) {
+            auto perm = utils::get_order(cols[j]);
+            ties[j] = impl::tie_profile_sorted(utils::permute(cols[j], perm),
+                                               utils::permute(w, perm));
+        });
+        sums = (w.size() > 0) ? utils::power_sums(w, 3) :
+            utils::unit_power_sums(n, 3);
+    }
+    // exact null distributions apply to unweighted pairs without ties
+    std::vector<char> untied(d, false);
+    if (shared && (w.size() == 0) &&
+        (methods::is_kendall(method) || methods::is_spearman(method)) &&
+        (n <= std::max(impl::ktau_exact_n_max, impl::srho_exact_n_max))) {
+        for (size_t j = 0; j < d; j++) {
+            untied[j] = methods::is_kendall(method) ? (ties[j].pairs == 0.0)
+                                                    : !utils::has_ties(cols[j]);
+        }
+    }
+    std::vector<impl::Dcor_margin> margins;
+    if (shared && methods::is_distance(method)) {
+        margins.resize(d);
+        utils::parallel_for(d, num_threads, [&] (size_t j, size_t) {
+            margins[j] = impl::dcor_margin(cols[j], w, utils::get_order(cols[j]));
+        });
+    }
+    std::vector<std::vector<size_t>> orders;
+    std::vector<impl::Xi_response> responses;
+    if (shared && methods::is_xi(method)) {
+        orders.resize(d);
+        responses.resize(d);
+        auto key = random::make_key(impl::xi_default_seeds());
+        utils::parallel_for(d, num_threads, [&] (size_t j, size_t) {
+            orders[j] = impl::xi_order(cols[j], key);
+            responses[j] = impl::xi_response(cols[j], w);
+        });
+    }
+
+    bool symmetric = methods::is_symmetric(method);
+    std::vector<std::pair<size_t, size_t>> pairs;
+    for (size_t i = 0; i < d; i++) {
+        for (size_t j = symmetric ? i + 1 : 0; j < d; j++) {
+            if (j != i)
+                pairs.push_back(std::make_pair(i, j));
+        }
+    }
+
+    Indep_test_matrix res;
+    res.estimate = Eigen::MatrixXd::Identity(d, d);
+    res.statistic = Eigen::MatrixXd::Constant(
+        d, d, std::numeric_limits<double>::quiet_NaN());
+    res.p_value = res.statistic;
+    std::vector<double> p(pairs.size());
+    utils::parallel_for(pairs.size(), num_threads, [&] (size_t k, size_t) {
+        size_t i = pairs[k].first, j = pairs[k].second;
+        Indep_test test = [&] {
+            if (!shared) {
+                return Indep_test(cols[i], cols[j], method, w,
+                                  remove_missing, alternative);
+            }
+            if (methods::is_distance(method)) {
+                return Indep_test(
+                    method,
+                    impl::dcor_from_margins(margins[i], margins[j], w),
+                    n_eff,
+                    impl::dcor_stat_scale(margins[i]) *
+                        impl::dcor_stat_scale(margins[j]),
+                    alternative);
+            }
+            if (methods::is_xi(method)) {
+                return Indep_test(
+                    method,
+                    impl::xi_from_order(orders[i], responses[j], w),
+                    n_eff,
+                    1.0 / responses[j].tau,
+                    alternative);
+            }
+            double ktau_adjust = 0.0;
+            if (methods::is_kendall(method))
+                ktau_adjust =
+                    impl::ktau_stat_adjust_from_ties(ties[i], ties[j], sums);
+            return Indep_test(method, wdm(cols[i], cols[j], method, w, false),
+                              n_eff, ktau_adjust, alternative,
+                              untied[i] && untied[j]);
+        }();
+        res.estimate(i, j) = test.estimate();
+        res.statistic(i, j) = test.statistic();
+        if (symmetric) {
+            res.estimate(j, i) = test.estimate();
+            res.statistic(j, i) = test.statistic();
+        }
+        p[k] = test.p_value();
+    });
+
+    p = utils::p_adjust(p, p_adjust);
+    for (size_t k = 0; k < pairs.size(); k++) {
+        size_t i = pairs[k].first, j = pairs[k].second;
+        res.p_value(i, j) = p[k];
+        if (symmetric)
+            res.p_value(j, i) = p[k];
+    }
+
+    return res;
+}
+
+namespace impl {
+
+//! checks dimensions and computes ranks or pseudo-observations of a matrix;
+//! see `rank_matrix()`.
+inline void rank_columns(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                         Eigen::Ref<Eigen::MatrixXd> out,
+                         const Eigen::VectorXd& weights,
+                         std::string ties_method,
+                         bool pseudo_obs,
+                         std::vector<int> seeds,
+                         size_t num_threads)
+{
+    if ((out.rows() != x.rows()) || (out.cols() != x.cols()))
+        throw std::runtime_error("x and out must have the same dimensions.");
+    if ((weights.size() > 0) && (weights.size() != x.rows()))
+        throw std::runtime_error("weights and data must have same size.");
+    rank_columns(x.data(), x.outerStride(), x.rows(), x.cols(),
+                 out.data(), out.outerStride(),
+                 weights.size() > 0 ? weights.data() : nullptr,
+                 ties_method, pseudo_obs, seeds, num_threads);
+}
+
+}
+
+//! computes (weighted) ranks for all columns of a matrix in parallel.
+//! @param x input data.
+//! @param out the output; must have the same dimensions as `x` and may be a
+//!    block of a larger matrix.
+//! @param weights an optional vector of weights for the data.
+//! @param ties_method `"average"` (default), `"min"`, `"first"`, or
+//!    `"random"`.
+//! @param seeds seeds of the random number generator; if empty (default),
+//!    the random number generator is seeded randomly.
+//! @param num_threads number of threads; `0` (default) uses all available
+//!    cores.
+//! @details See the raw-buffer version of `rank_matrix()`.
+inline void rank_matrix(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                        Eigen::Ref<Eigen::MatrixXd> out,
+                        const Eigen::VectorXd& weights = Eigen::VectorXd(),
+                        std::string ties_method = "average",
+                        std::vector<int> seeds = std::vector<int>(),
+                        size_t num_threads = 0)
+{
+    impl::rank_columns(x, out, weights, ties_method, false, seeds,
+                       num_threads);
+}
+
+//! computes (weighted) pseudo-observations for all columns of a matrix in
+//! parallel; arguments are as in `rank_matrix()`.
+inline void pseudo_obs(const Eigen::Ref<const Eigen::MatrixXd>& x,
+                       Eigen::Ref<Eigen::MatrixXd> out,
+                       const Eigen::VectorXd& weights = Eigen::VectorXd(),
+                       std::string ties_method = "average",
+                       std::vector<int> seeds = std::vector<int>(),
+                       size_t num_threads = 0)
+{
+    impl::rank_columns(x, out, weights, ties_method, true, seeds,
+                       num_threads);
+}
+
 }
@@ -0,0 +1,519 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "ktau.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <sstream>
+
+namespace wdm {
+
+//! a function that reads the next chunk of data for out-of-core
+//! computations.
+//!
+//! It is called as `reader(x, y, w, max_records)`, must store at most
+//! `max_records` observations in the arrays `x`, `y`, and `w` (the latter is
+//! `nullptr` if no weights are used), and returns the number of
+//! observations stored; `0` signals the end of the data (also for any
+//! further calls).
+typedef std::function<size_t(double*, double*, double*, size_t)> Chunk_reader;
+
+namespace impl {
+
+//! an observation for the external sort in x order.
+struct Xyw_record {
+    double x;
+    double y;
+    double w;
+};
+
+//! an unweighted observation for the external sort in x order.
+struct Xy_record {
+    double x;
+    double y;
+};
+
+//! an observation for the external sort in y order.
+struct Yw_record {
+    double y;
+    double w;
+};
+
+//! a binary temporary file that is removed on destruction.
+class Temp_file {
+public:
+    //! @param dir the directory in which the file is created.
+    explicit Temp_file(const std::string& dir)
+    {
+        static std::atomic<size_t> counter(0);
+        std::random_device rd;
+        std::stringstream name;
+        name << dir << "/wdm-" << std::hex << rd() << "-" << counter++ << ".tmp";
+        path_ = name.str();
+        file_ = std::fopen(path_.c_str(), "w+b");
+        if (!file_)
+            throw std::runtime_error("cannot create temporary file " + path_);
+    }
+
+    ~Temp_file()
+    {
+        std::fclose(file_);
+        std::remove(path_.c_str());
+    }
+
+    Temp_file(const Temp_file&) = delete;
+    Temp_file& operator=(const Temp_file&) = delete;
+
+    template<class T>
+    void write(const T* data, size_t n)
+    {
+        WDM_PROFILE_SCOPE("io", n);
+        if (std::fwrite(data, sizeof(T), n, file_) != n)
+            throw std::runtime_error("cannot write to temporary file " + path_);
+    }
+
+    template<class T>
+    size_t read(T* data, size_t n)
+    {
+        WDM_PROFILE_SCOPE("io", n);
+        return std::fread(data, sizeof(T), n, file_);
+    }
+
+    void rewind() { std::rewind(file_); }
+
+private:
+    std::string path_;
+    std::FILE* file_;
+};
+
+//! sequential, buffered access to a sorted run stored in a temporary file.
+template<class T>
+class Run_reader {
+public:
+    //! @param file the file holding the run; is rewound.
+    //! @param buffer_size the number of records held in memory.
+    Run_reader(Temp_file& file, size_t buffer_size) :
+        file_(&file),
+        buffer_(std::max(buffer_size, static_cast<size_t>(1))),
+        pos_(0),
+        size_(0)
+    {
+        file_->rewind();
+        fill();
+    }
+
+    bool empty() const { return pos_ == size_; }
+    const T& front() const { return buffer_[pos_]; }
+
+    void pop()
+    {
+        if (++pos_ == size_)
+            fill();
+    }
+
+private:
+    void fill()
+    {
+        size_ = file_->read(buffer_.data(), buffer_.size());
+        pos_ = 0;
+    }
+
+    Temp_file* file_;
+    std::vector<T> buffer_;
+    size_t pos_;
+    size_t size_;
+};
+
+//! sorts records by y while counting weighted inversions.
+//! @param v the records; sorted on exit.
+//! @param buf a buffer of the same size.
+//! @return the weighted number of pairs \f$ i < j \f$ with `v[i].y > v[j].y`.
+inline double sort_count_inversions(std::vector<Yw_record>& v,
+                                    std::vector<Yw_record>& buf)
+{
+    size_t n = v.size();
+    buf.resize(n);
+    double count = 0.0;
+    for (size_t width = 1; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            size_t mid = std::min(lo + width, n), hi = std::min(mid + width, n);
+            double w_left = 0.0;
+            for (size_t i = lo; i < mid; i++)
+                w_left += v[i].w;
+            size_t i = lo, j = mid, k = lo;
+            while ((i < mid) && (j < hi)) {
+                if (v[i].y <= v[j].y) {
+                    w_left -= v[i].w;
+                    buf[k++] = v[i++];
+                } else {
+                    count += v[j].w * w_left;
+                    buf[k++] = v[j++];
+                }
+            }
+            std::copy(v.begin() + i, v.begin() + mid, buf.begin() + k);
+            std::copy(v.begin() + j, v.begin() + hi,
+                      buf.begin() + k + (mid - i));
+        }
+        v.swap(buf);
+    }
+
+    return count;
+}
+
+//! accumulates the (weighted) number of tied pairs in a sorted stream.
+//! @tparam C the type of the counts; `uint64_t` counts unweighted pairs
+//!   exactly.
+template<class C>
+class Tie_counter {
+public:
+    Tie_counter() : count_(0), w1_(0), w2_(0) {}
+
+    //! adds an observation; `tied` indicates whether it is tied with the
+    //! previous one.
+    void add(bool tied, C w)
+    {
+        if (!tied)
+            flush();
+        w1_ += w;
+        w2_ += w * w;
+    }
+
+    C count()
+    {
+        flush();
+        return count_;
+    }
+
+private:
+    void flush()
+    {
+        count_ += (w1_ * w1_ - w2_) / 2;
+        w1_ = w2_ = 0;
+    }
+
+    C count_;
+    C w1_;
+    C w2_;
+};
+
+//! record types and counts of the out-of-core algorithm for a weight policy.
+template<class W>
+struct External_traits;
+
+//! weighted data: records carry their weights and counts are accumulated in
+//! `double`.
+template<>
+struct External_traits<utils::Weighted> {
+    typedef Xyw_record Xy_rec;
+    typedef Yw_record Y_rec;
+    typedef double Count;
+
+    static Xy_rec make(double x, double y, double w) { return Xy_rec{x, y, w}; }
+    static Y_rec to_y(const Xy_rec& r) { return Y_rec{r.y, r.w}; }
+    static double weight(const Xy_rec& r) { return r.w; }
+    static double weight(const Y_rec& r) { return r.w; }
+    static double y(const Y_rec& r) { return r.y; }
+
+    static double sort_count_inversions(std::vector<Y_rec>& v,
+                                        std::vector<Y_rec>& buf)
+    {
+        return impl::sort_count_inversions(v, buf);
+    }
+
+    static double tau(double num_pairs, double num_d, double ties_x,
+                      double ties_y, double ties_both)
+    {
+        return ktau_from_counts(num_pairs, num_d, ties_x, ties_y, ties_both);
+    }
+};
+
+//! unweighted data: records carry no weights and all counts are exact
+//! integers (as in `ktau_sorted_unweighted()`).
+template<>
+struct External_traits<utils::Unweighted> {
+    typedef Xy_record Xy_rec;
+    typedef double Y_rec;
+    typedef uint64_t Count;
+
+    static Xy_rec make(double x, double y, double) { return Xy_rec{x, y}; }
+    static Y_rec to_y(const Xy_rec& r) { return r.y; }
+    static uint64_t weight(const Xy_rec&) { return 1; }
+    static uint64_t weight(double) { return 1; }
+    static double y(double r) { return r; }
+
+    static uint64_t sort_count_inversions(std::vector<Y_rec>& v,
+                                          std::vector<Y_rec>&)
+    {
+        return utils::count_inversions(v);
+    }
+
+    static double tau(uint64_t num_pairs, uint64_t num_d, uint64_t ties_x,
+                      uint64_t ties_y, uint64_t ties_both)
+    {
+        return ktau_from_exact_counts(num_pairs, num_d, ties_x, ties_y,
+                                      ties_both);
+    }
+};
+
+//! resolves the directory for temporary files.
+inline std::string temp_dir(std::string dir)
+{
+    if (!dir.empty())
+        return dir;
+    for (const char* var : {"TMPDIR", "TEMP", "TMP"}) {
+        if (const char* value = std::getenv(var))
+            return value;
+    }
+    return ".";
+}
+
+//! calculates the (weighted) Kendall's tau out of core; see `ktau_external()`.
+//! @tparam W the weight policy (see `utils::Weighted`); unweighted data is
+//!   processed with weightless records and exact integer counts.
+template<class W>
+double ktau_external(const Chunk_reader& reader,
+                     size_t memory_budget,
+                     std::string temp_dir)
+{
+    typedef External_traits<W> T;
+    typedef typename T::Xy_rec Xy_rec;
+    typedef typename T::Y_rec Y_rec;
+    typedef typename T::Count Count;
+
+    WDM_PROFILE_SCOPE("external", 0);
+    temp_dir = impl::temp_dir(temp_dir);
+    // the first phase holds the reader's arrays and the records
+    size_t chunk_size = std::max(memory_budget / (2 * sizeof(Xy_rec)),
+                                 static_cast<size_t>(2));
+    std::vector<double> x(chunk_size), y(chunk_size), w;
+    if (W::weighted)
+        w.resize(chunk_size);
+
+    // reads a chunk without missing values, returns false at the end
+    std::vector<Xy_rec> records;
+    auto read_chunk = [&] {
+        records.clear();
+        size_t m;
+        while ((records.size() < chunk_size) &&
+               (m = reader(x.data(), y.data(), W::weighted ? w.data() : nullptr,
+                           chunk_size - records.size())) > 0) {
+            for (size_t i = 0; i < m; i++) {
+                double wi = W::weighted ? w[i] : 1.0;
+                if (!std::isnan(x[i]) && !std::isnan(y[i]) && !std::isnan(wi))
+                    records.push_back(T::make(x[i], y[i], wi));
+            }
+        }
+        return records.size() > 0;
+    };
+
+    // 1. Sort chunks in x order (ties broken by y) and write them to runs.
+    auto by_xy = [] (const Xy_rec& a, const Xy_rec& b) {
+        return (a.x < b.x) || ((a.x == b.x) && (a.y < b.y));
+    };
+    std::vector<std::unique_ptr<Temp_file>> xy_runs;
+    while (read_chunk()) {
+        if (xy_runs.empty() && (records.size() < chunk_size)) {
+            // everything fits into memory
+            std::vector<double> xs(records.size()), ys(records.size()),
+                ws(W::weighted ? records.size() : 0);
+            for (size_t i = 0; i < records.size(); i++) {
+                xs[i] = records[i].x;
+                ys[i] = records[i].y;
+                if (W::weighted)
+                    ws[i] = T::weight(records[i]);
+            }
+            return ktau(xs, ys, ws);
+        }
+        {
+            WDM_PROFILE_SCOPE("sort", records.size());
+            std::sort(records.begin(), records.end(), by_xy);
+        }
+        xy_runs.emplace_back(new Temp_file(temp_dir));
+        xy_runs.back()->write(records.data(), records.size());
+    }
+    if (xy_runs.empty())
+        return std::numeric_limits<double>::quiet_NaN();
+    std::vector<double>().swap(x);
+    std::vector<double>().swap(y);
+    std::vector<double>().swap(w);
+    std::vector<Xy_rec>().swap(records);
+
+    // 2. Merge the runs in x order, counting ties in x and in (x, y). The
+    // merged stream is cut into blocks that are sorted in y order (counting
+    // the inversions within blocks) and written to new runs.
+    size_t k = xy_runs.size();
+    std::vector<Run_reader<Xy_rec>> xy_readers;
+    for (auto& run : xy_runs) {
+        xy_readers.emplace_back(
+            *run, memory_budget / (2 * k * sizeof(Xy_rec)));
+    }
+    size_t block_size = std::max(memory_budget / (4 * sizeof(Y_rec)),
+                                 static_cast<size_t>(1));
+    std::vector<Y_rec> block, buf;
+    block.reserve(block_size);
+    std::vector<std::unique_ptr<Temp_file>> y_runs;
+    std::vector<Count> run_weights;
+    Count num_d = 0;
+    auto write_block = [&] {
+        {
+            WDM_PROFILE_SCOPE("merge_sort", block.size());
+            num_d += T::sort_count_inversions(block, buf);
+        }
+        Count w_run = 0;
+        for (const auto& r : block)
+            w_run += T::weight(r);
+        run_weights.push_back(w_run);
+        y_runs.emplace_back(new Temp_file(temp_dir));
+        y_runs.back()->write(block.data(), block.size());
+        block.clear();
+    };
+
+    typedef std::pair<Xy_rec, size_t> Xy_head;
+    auto xy_greater = [&] (const Xy_head& a, const Xy_head& b) {
+        return by_xy(b.first, a.first);
+    };
+    std::priority_queue<Xy_head, std::vector<Xy_head>, decltype(xy_greater)>
+        xy_heap(xy_greater);
+    for (size_t r = 0; r < k; r++) {
+        if (!xy_readers[r].empty())
+            xy_heap.push(Xy_head(xy_readers[r].front(), r));
+    }
+
+    Tie_counter<Count> ties_x, ties_both;
+    Xy_rec last = T::make(NAN, NAN, 0.0);
+    Count s1 = 0, s2 = 0;
+    while (!xy_heap.empty()) {
+        Xy_rec rec = xy_heap.top().first;
+        size_t r = xy_heap.top().second;
+        xy_heap.pop();
+        xy_readers[r].pop();
+        if (!xy_readers[r].empty())
+            xy_heap.push(Xy_head(xy_readers[r].front(), r));
+
+        Count wr = T::weight(rec);
+        ties_x.add(rec.x == last.x, wr);
+        ties_both.add((rec.x == last.x) && (rec.y == last.y), wr);
+        s1 += wr;
+        s2 += wr * wr;
+        last = rec;
+
+        block.push_back(T::to_y(rec));
+        if (block.size() == block_size)
+            write_block();
+    }
+    if (block.size() > 0)
+        write_block();
+    xy_readers.clear();
+    xy_runs.clear();
+    std::vector<Y_rec>().swap(block);
+    std::vector<Y_rec>().swap(buf);
+
+    // 3. Merge the runs in y order (ties broken by run), counting ties in y
+    // and the inversions across runs: an observation from run r is
+    // discordant with all observations from earlier runs that have a larger
+    // y, i.e., that have not been merged yet. (Without weights, the tree
+    // holds counts below 2^53, which are exact in double precision.)
+    k = y_runs.size();
+    std::vector<Run_reader<Y_rec>> y_readers;
+    for (auto& run : y_runs)
+        y_readers.emplace_back(*run, memory_budget / (k * sizeof(Y_rec)));
+    std::vector<Count> w_before(k, 0);
+    for (size_t r = 1; r < k; r++)
+        w_before[r] = w_before[r - 1] + run_weights[r - 1];
+    utils::Fenwick_tree merged(k, 1);
+
+    typedef std::pair<Y_rec, size_t> Y_head;
+    auto y_greater = [] (const Y_head& a, const Y_head& b) {
+        return (T::y(a.first) > T::y(b.first)) ||
+            ((T::y(a.first) == T::y(b.first)) && (a.second > b.second));
+    };
+    std::priority_queue<Y_head, std::vector<Y_head>, decltype(y_greater)>
+        y_heap(y_greater);
+    for (size_t r = 0; r < k; r++) {
+        if (!y_readers[r].empty())
+            y_heap.push(Y_head(y_readers[r].front(), r));
+    }
+
+    Tie_counter<Count> ties_y;
+    double last_y = NAN, w_merged;
+    while (!y_heap.empty()) {
+        Y_rec rec = y_heap.top().first;
+        size_t r = y_heap.top().second;
+        y_heap.pop();
+        y_readers[r].pop();
+        if (!y_readers[r].empty())
+            y_heap.push(Y_head(y_readers[r].front(), r));
+
+        Count wr = T::weight(rec);
+        double wd = static_cast<double>(wr);
+        merged.prefix_sum(r, &w_merged);
+        num_d += wr * (w_before[r] - static_cast<Count>(w_merged));
+        merged.add(r + 1, &wd);
+        ties_y.add(T::y(rec) == last_y, wr);
+        last_y = T::y(rec);
+    }
+
+    return T::tau((s1 * s1 - s2) / 2, num_d,
+                  ties_x.count(), ties_y.count(), ties_both.count());
+}
+
+//! calculates the (weighted) Kendall's tau out of core; see `ktau_external()`.
+inline double ktau_external(const Chunk_reader& reader,
+                            bool weighted,
+                            size_t memory_budget,
+                            std::string temp_dir)
+{
+    if (weighted)
+        return ktau_external<utils::Weighted>(reader, memory_budget, temp_dir);
+    return ktau_external<utils::Unweighted>(reader, memory_budget, temp_dir);
+}
+
+}
+
+//! calculates the (weighted) Kendall's tau for data that does not fit into
+//! memory.
+//!
+//! The data is read in chunks that are sorted in x order and stored in
+//! temporary files (runs). The runs are merged while counting ties in x;
+//! the merged stream is cut into blocks that are sorted in y order, counting
+//! the inversions within blocks, and the inversions across blocks are
+//! counted while merging the blocks. The data is read once and written to
+//! disk twice.
+//!
+//! @param reader a function reading the next chunk of data; see
+//!    `Chunk_reader`.
+//! @param weighted whether the reader provides weights.
+//! @param memory_budget (approximate) number of bytes used for buffers.
+//! @param temp_dir directory for the temporary files; if empty (default),
+//!    the directory given by the environment variables `TMPDIR`, `TEMP`, or
+//!    `TMP`, or the working directory.
+//!
+//! @details
+//! Without weights, all pair counts are exact 64-bit integers (for up to
+//! about \f$ 4 \cdot 10^9 \f$ observations); with weights, they are
+//! accumulated in double precision.
+//! Observations containing a `nan` are removed. If all data fits into the
+//! memory budget, the computation is done in memory. The number of
+//! temporary files open at the same time is about the size of the data
+//! divided by the memory budget.
+//!
+//! @return Kendall's \f$ \tau \f$; `nan` if there is no data.
+inline double ktau_external(const Chunk_reader& reader,
+                            bool weighted = false,
+                            size_t memory_budget = size_t(1) << 30,
+                            std::string temp_dir = "")
+{
+    return impl::ktau_external(reader, weighted, memory_budget, temp_dir);
+}
+
+}
@@ -0,0 +1,391 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "../wdm.hpp"
+
+namespace wdm {
+
+namespace impl {
+
+//! observations segmented into groups.
+struct Group_index {
+    std::vector<size_t> labels;   //!< distinct group labels in ascending order.
+    std::vector<size_t> offsets;  //!< start of each group in `order`, followed by the number of observations.
+    std::vector<size_t> order;    //!< observations sorted by group.
+};
+
+//! segments the observations into groups.
+//! @param groups group label of each observation.
+//! @details Labels that are at most the number of observations (e.g.,
+//!   indices) are segmented by a counting sort in linear time; other labels
+//!   are sorted.
+inline Group_index group_index(const std::vector<size_t>& groups)
+{
+    size_t n = groups.size();
+    WDM_PROFILE_SCOPE("sort", n);
+    Group_index idx;
+    idx.order.resize(n);
+    size_t max_label = 0;
+    for (auto g : groups)
+        max_label = std::max(max_label, g);
+
+    if (max_label <= n) {
+        std::vector<size_t> counts(max_label + 2, 0);
+        for (auto g : groups)
+            counts[g + 1]++;
+        for (size_t l = 0; l <= max_label; l++) {
+            if (counts[l + 1] > 0) {
+                idx.labels.push_back(l);
+                idx.offsets.push_back(counts[l]);
+            }
+            counts[l + 1] += counts[l];
+        }
+        for (size_t i = 0; i < n; i++)
+            idx.order[counts[groups[i]]++] = i;
+    } else {
+        std::vector<std::pair<size_t, size_t>> keys(n);
+        for (size_t i = 0; i < n; i++)
+            keys[i] = std::make_pair(groups[i], i);
+        std::sort(keys.begin(), keys.end());
+        for (size_t k = 0; k < n; k++) {
+            idx.order[k] = keys[k].second;
+            if ((k == 0) || (keys[k].first != keys[k - 1].first)) {
+                idx.labels.push_back(keys[k].first);
+                idx.offsets.push_back(k);
+            }
+        }
+    }
+    idx.offsets.push_back(n);
+
+    return idx;
+}
+
+//! quantities of a group entering the tests and the stratified estimators.
+struct Group_stats {
+    double estimate;     //!< the dependence measure.
+    double n_eff;        //!< the effective sample size.
+    double stat_adjust;  //!< the adjustment of the test statistic (see `Indep_test`).
+    double pairs_x;      //!< (weighted) number of pairs not tied in x (Kendall only).
+    double pairs_y;      //!< (weighted) number of pairs not tied in y (Kendall only).
+    bool exact_null;     //!< whether the exact null distribution applies (see `Indep_test`).
+};
+
+//! computes the dependence measure of a group and the quantities entering
+//! its independence test.
+//! @param x, y input data.
+//! @param weights vector of weights for the data; can be empty.
+//! @param idx the segmentation of the data (see `group_index()`).
+//! @param g the index of the group.
+//! @param method the dependence measure.
+inline Group_stats group_stats(const std::vector<double>& x,
+                               const std::vector<double>& y,
+                               const std::vector<double>& weights,
+                               const Group_index& idx,
+                               size_t g,
+                               const std::string& method)
+{
+    // the complete observations of the group
+    std::vector<double> xs, ys, ws;
+    for (size_t k = idx.offsets[g]; k < idx.offsets[g + 1]; k++) {
+        size_t i = idx.order[k];
+        if (std::isnan(x[i]) || std::isnan(y[i]) ||
+            ((weights.size() > 0) && std::isnan(weights[i])))
+            continue;
+        xs.push_back(x[i]);
+        ys.push_back(y[i]);
+        if (weights.size() > 0)
+            ws.push_back(weights[i]);
+    }
+    size_t m = xs.size();
+
+    Group_stats s;
+    s.n_eff = utils::effective_sample_size(m, ws);
+    s.stat_adjust = 0.0;
+    s.pairs_x = 0.0;
+    s.pairs_y = 0.0;
+    s.exact_null = false;
+    if (m < methods::get_min_nobs(method)) {
+        s.estimate = std::numeric_limits<double>::quiet_NaN();
+        return s;
+    }
+
+    if (methods::is_kendall(method)) {
+        // the tie adjustment reuses the sorts of the estimate
+        utils::sort_all(xs, ys, ws);
+        auto ws_x = ws;
+        s.estimate = ktau_sorted(xs, ys, ws);
+        auto ties_x = tie_profile_sorted(xs, ws_x);
+        auto ties_y = tie_profile_sorted(ys, ws);
+        auto sums = (ws.size() > 0) ? utils::power_sums(ws, 3) :
+            utils::unit_power_sums(m, 3);
+        s.stat_adjust = ktau_stat_adjust_from_ties(ties_x, ties_y, sums);
+        double num_pairs = utils::perm_sum_from_power_sums(sums, 2);
+        s.pairs_x = num_pairs - ties_x.pairs;
+        s.pairs_y = num_pairs - ties_y.pairs;
+        s.exact_null = (ws.size() == 0) && (ties_x.pairs == 0.0) &&
+            (ties_y.pairs == 0.0);
+    } else if (methods::is_distance(method) || methods::is_xi(method)) {
+        double ktau_adjust = 0.0, dcor_adjust = 0.0, xi_adjust = 0.0;
+        s.estimate = wdm_all(xs, ys, {method}, ws, ktau_adjust, dcor_adjust,
+                             xi_adjust)[0];
+        if (methods::is_distance(method))
+            s.stat_adjust = dcor_adjust;
+        if (methods::is_xi(method))
+            s.stat_adjust = xi_adjust;
+    } else {
+        s.estimate = wdm(xs, ys, method, ws, false);
+        if (methods::is_spearman(method))
+            s.exact_null = impl::use_exact_null(xs, ys, ws);
+    }
+
+    return s;
+}
+
+//! segments the data and computes the quantities of all groups in parallel.
+//! @param x, y input data.
+//! @param groups group label of each observation.
+//! @param method the dependence measure.
+//! @param weights vector of weights for the data; can be empty.
+//! @param remove_missing if `false`, throws an error if `nan`s are present.
+//! @param num_threads number of threads.
+inline std::vector<Group_stats> group_stats_all(const std::vector<double>& x,
+                                                const std::vector<double>& y,
+                                                const std::vector<size_t>& groups,
+                                                const std::string& method,
+                                                const std::vector<double>& weights,
+                                                bool remove_missing,
+                                                size_t num_threads)
+{
+    WDM_PROFILE_SCOPE("grouped", x.size());
+    utils::check_sizes(x, y, weights);
+    if (groups.size() != x.size())
+        throw std::runtime_error("groups and data must have same size.");
+    if (!methods::is_hoeffding(method) && !methods::is_kendall(method) &&
+        !methods::is_pearson(method) && !methods::is_spearman(method) &&
+        !methods::is_blomqvist(method) && !methods::is_distance(method) &&
+        !methods::is_xi(method))
+        throw std::runtime_error("method not implemented.");
+    if (!remove_missing &&
+        (utils::any_nan(x) || utils::any_nan(y) || utils::any_nan(weights)))
+        throw std::runtime_error("there are missing values in the data; "
+                                 "try remove_missing = TRUE");
+
+    auto idx = group_index(groups);
+    size_t num_groups = idx.labels.size();
+    if (!remove_missing) {
+        for (size_t g = 0; g < num_groups; g++) {
+            if (idx.offsets[g + 1] - idx.offsets[g] < methods::get_min_nobs(method)) {
+                std::stringstream msg;
+                msg << "need at least " << methods::get_min_nobs(method) <<
+                       " observations in each group.";
+                throw std::runtime_error(msg.str());
+            }
+        }
+    }
+
+    std::vector<Group_stats> stats(num_groups);
+    utils::parallel_for(num_groups, num_threads, [&] (size_t g, size_t) {
+        stats[g] = group_stats(x, y, weights, idx, g, method);
+    });
+
+    return stats;
+}
+
+}
+
+//! extracts the distinct group labels in ascending order, which is the order
+//! of the results of `wdm_grouped()` and `indep_test_grouped()`.
+//! @param groups group label of each observation.
+inline std::vector<size_t> group_labels(std::vector<size_t> groups)
+{
+    std::sort(groups.begin(), groups.end());
+    groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
+    return groups;
+}
+
+//! calculates a (weighted) dependence measure for each group of observations.
+//!
+//! The observations are segmented by a single pass over the group labels
+//! (a counting sort for labels that are at most the number of observations);
+//! the groups are then processed in parallel. In tests, the estimate and the
+//! adjustment of the test statistic share the sorts of a group.
+//!
+//! @param x, y input data.
+//! @param groups group label of each observation (e.g., the index of a
+//!    customer, region, or day).
+//! @param method the dependence measure; see `wdm()` for possible values.
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed; otherwise throws an error if `nan`s are present.
+//! @param num_threads number of threads; `0` (default) uses all available
+//!    cores.
+//!
+//! @return a vector containing the dependence measure for each group, in
+//!    ascending order of the group labels (see `group_labels()`).
+inline std::vector<double> wdm_grouped(const std::vector<double>& x,
+                                       const std::vector<double>& y,
+                                       const std::vector<size_t>& groups,
+                                       std::string method,
+                                       const std::vector<double>& weights = std::vector<double>(),
+                                       bool remove_missing = true,
+                                       size_t num_threads = 0)
+{
+    auto stats = impl::group_stats_all(x, y, groups, method, weights,
+                                       remove_missing, num_threads);
+    std::vector<double> res(stats.size());
+    for (size_t g = 0; g < stats.size(); g++)
+        res[g] = stats[g].estimate;
+
+    return res;
+}
+
+//! performs a (weighted) independence test for each group of observations;
+//! see `wdm_grouped()` for details.
+//! @param x, y input data.
+//! @param groups group label of each observation.
+//! @param method the dependence measure; see `Indep_test` for possible values.
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed; otherwise throws an error if `nan`s are present.
+//! @param alternative indicates the alternative hypothesis; see `Indep_test`.
+//! @param num_threads number of threads; `0` (default) uses all available
+//!    cores.
+//!
+//! @return a vector containing an `Indep_test` for each group, in ascending
+//!    order of the group labels (see `group_labels()`).
+inline std::vector<Indep_test> indep_test_grouped(
+    const std::vector<double>& x,
+    const std::vector<double>& y,
+    const std::vector<size_t>& groups,
+    std::string method,
+    const std::vector<double>& weights = std::vector<double>(),
+    bool remove_missing = true,
+    std::string alternative = "two-sided",
+    size_t num_threads = 0)
+{
+    auto stats = impl::group_stats_all(x, y, groups, method, weights,
+                                       remove_missing, num_threads);
+    std::vector<Indep_test> tests;
+    tests.reserve(stats.size());
+    for (const auto& s : stats) {
+        tests.push_back(Indep_test(method, s.estimate, s.n_eff, s.stat_adjust,
+                                   alternative, s.exact_null));
+    }
+
+    return tests;
+}
+
+//! performs a (weighted) stratified independence test, pooling the groups
+//! of observations.
+//!
+//! Only pairs of observations within the same group are compared, so that
+//! differences between the groups do not enter the estimate.
+//!   - Kendall's \f$ \tau \f$: the stratified coefficient counts concordant
+//!     minus discordant pairs over all groups and normalizes by the pooled
+//!     numbers of pairs not tied in x and y. The test statistic is the
+//!     pooled numerator divided by its standard deviation, which adds up over
+//!     the groups.
+//!   - Spearman's \f$ \rho \f$: the group estimates are pooled on the Fisher
+//!     scale with weights \f$ n_g - 3 \f$ (the inverse of the asymptotic
+//!     variances), where \f$ n_g \f$ is the effective sample size of a
+//!     group. The test uses the pooled effective sample size
+//!     \f$ 3 + \sum_g (n_g - 3) \f$.
+//!
+//! Groups whose estimate is not available (too few observations, constant
+//! variables) are ignored. The p-value is always asymptotic, since the exact
+//! null distributions of single samples do not apply to pooled estimates.
+//!
+//! @param x, y input data.
+//! @param groups group label of each observation.
+//! @param method the dependence measure; either Kendall's \f$ \tau \f$ or
+//!    Spearman's \f$ \rho \f$ (or their aliases, see `wdm()`).
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed; otherwise throws an error if `nan`s are present.
+//! @param alternative indicates the alternative hypothesis; see `Indep_test`.
+//! @param num_threads number of threads; `0` (default) uses all available
+//!    cores.
+//!
+//! @return an `Indep_test` holding the stratified estimate.
+inline Indep_test indep_test_stratified(
+    const std::vector<double>& x,
+    const std::vector<double>& y,
+    const std::vector<size_t>& groups,
+    std::string method,
+    const std::vector<double>& weights = std::vector<double>(),
+    bool remove_missing = true,
+    std::string alternative = "two-sided",
+    size_t num_threads = 0)
+{
+    if (!methods::is_kendall(method) && !methods::is_spearman(method))
+        throw std::runtime_error("stratified estimators are only available "
+                                 "for kendall and spearman.");
+    auto stats = impl::group_stats_all(x, y, groups, method, weights,
+                                       remove_missing, num_threads);
+
+    double estimate = std::numeric_limits<double>::quiet_NaN();
+    double n_eff = 0.0, stat_adjust = 0.0;
+    if (methods::is_kendall(method)) {
+        // numerators S_g = tau_g sqrt(A_g B_g) with sd sqrt(A_g B_g) / adj_g
+        double num = 0.0, pairs_x = 0.0, pairs_y = 0.0, var = 0.0;
+        for (const auto& s : stats) {
+            double ab = s.pairs_x * s.pairs_y;
+            if (std::isnan(s.estimate) || !(ab > 0.0))
+                continue;
+            num += s.estimate * std::sqrt(ab);
+            pairs_x += s.pairs_x;
+            pairs_y += s.pairs_y;
+            var += ab / (s.stat_adjust * s.stat_adjust);
+            n_eff += s.n_eff;
+        }
+        if (var > 0.0) {
+            estimate = num / std::sqrt(pairs_x * pairs_y);
+            stat_adjust = std::sqrt(pairs_x * pairs_y / var);
+        }
+    } else {
+        double z = 0.0, w_sum = 0.0;
+        for (const auto& s : stats) {
+            if (std::isnan(s.estimate) || !(s.n_eff > 3.0))
+                continue;
+            double rho = std::max(std::min(s.estimate, 1 - 1e-12), -1 + 1e-12);
+            z += (s.n_eff - 3) * std::atanh(rho);
+            w_sum += s.n_eff - 3;
+        }
+        if (w_sum > 0.0) {
+            estimate = std::tanh(z / w_sum);
+            n_eff = 3 + w_sum;
+        }
+    }
+
+    return Indep_test(method, estimate, n_eff, stat_adjust, alternative);
+}
+
+//! calculates a (weighted) stratified dependence measure, pooling the groups
+//! of observations; see `indep_test_stratified()` for details.
+//! @param x, y input data.
+//! @param groups group label of each observation.
+//! @param method the dependence measure; either Kendall's \f$ \tau \f$ or
+//!    Spearman's \f$ \rho \f$ (or their aliases, see `wdm()`).
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed; otherwise throws an error if `nan`s are present.
+//! @param num_threads number of threads; `0` (default) uses all available
+//!    cores.
+inline double wdm_stratified(const std::vector<double>& x,
+                             const std::vector<double>& y,
+                             const std::vector<size_t>& groups,
+                             std::string method,
+                             const std::vector<double>& weights = std::vector<double>(),
+                             bool remove_missing = true,
+                             size_t num_threads = 0)
+{
+    return indep_test_stratified(x, y, groups, method, weights, remove_missing,
+                                 "two-sided", num_threads).estimate();
+}
+
+}
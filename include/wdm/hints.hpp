@@ -0,0 +1,222 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "ktau.hpp"
+#include "srho.hpp"
+#include "bbeta.hpp"
+#include "nan_handling.hpp"
+
+namespace wdm {
+
+//! properties of the data known to the caller.
+//!
+//! Each hint allows `wdm()` and `Indep_test` to skip the work that
+//! establishes the property: scans for missing values, sorting, ranking, and
+//! tie counting. All hints are `false` by default. Unless `NDEBUG` is
+//! defined, the hints are verified and an error is thrown if one does not
+//! hold; in release builds, wrong hints lead to wrong results.
+struct Data_hints {
+    //! `x`, `y`, and the weights contain no `nan`s.
+    bool no_missing = false;
+    //! `x` is sorted in ascending order (the weights in the same order).
+    bool sorted = false;
+    //! neither `x` nor `y` contains ties.
+    bool no_ties = false;
+    //! `x` and `y` are both permutations of \f$ 1, \dots, n \f$ (implies
+    //! `no_ties`).
+    bool ranked = false;
+    //! the weights sum to one.
+    bool normalized_weights = false;
+};
+
+namespace impl {
+
+//! throws an error if a hint does not hold for the data; does nothing if
+//! `NDEBUG` is defined.
+//! @param x, y, weights input data.
+//! @param hints the hints.
+inline void check_hints(const std::vector<double>& x,
+                        const std::vector<double>& y,
+                        const std::vector<double>& weights,
+                        const Data_hints& hints)
+{
+#ifndef NDEBUG
+    auto fail = [] (std::string hint) {
+        throw std::runtime_error("hint '" + hint + "' does not hold.");
+    };
+    if (hints.no_missing &&
+        (utils::any_nan(x) || utils::any_nan(y) || utils::any_nan(weights)))
+        fail("no_missing");
+    if (hints.sorted && !std::is_sorted(x.begin(), x.end()))
+        fail("sorted");
+    if (hints.no_ties && (utils::has_ties(x) || utils::has_ties(y)))
+        fail("no_ties");
+    auto is_ranked = [] (const std::vector<double>& v) {
+        std::vector<bool> seen(v.size(), false);
+        for (double r : v) {
+            if (!(r >= 1) || (r > v.size()) || (r != std::floor(r)) ||
+                seen[static_cast<size_t>(r) - 1])
+                return false;
+            seen[static_cast<size_t>(r) - 1] = true;
+        }
+        return true;
+    };
+    if (hints.ranked && (!is_ranked(x) || !is_ranked(y)))
+        fail("ranked");
+    if (hints.normalized_weights && (weights.size() > 0) &&
+        !(std::fabs(utils::sum(weights) - 1.0) <= 1e-8))
+        fail("normalized_weights");
+#else
+    (void) x;
+    (void) y;
+    (void) weights;
+    (void) hints;
+#endif
+}
+
+//! calculates the effective sample size; see
+//! `utils::effective_sample_size()`.
+inline double effective_sample_size(size_t n,
+                                    const std::vector<double>& weights,
+                                    const Data_hints& hints)
+{
+    if (hints.normalized_weights && (weights.size() > 0))
+        return 1.0 / utils::sum(utils::pow(weights, 2));
+    return utils::effective_sample_size(n, weights);
+}
+
+//! calculates Kendall's tau from data in x order without ties.
+//! @param y, weights input data in x order; on exit, sorted in y order.
+inline double ktau_sorted_no_ties(std::vector<double>& y,
+                                  std::vector<double>& weights)
+{
+    if (weights.size() == 0) {
+        uint64_t num_d;
+        {
+            WDM_PROFILE_SCOPE("merge_sort", y.size());
+            num_d = utils::count_inversions(y);
+        }
+        uint64_t n = y.size();
+        uint64_t num_pairs = n * (n - 1) / 2;
+        int64_t numerator = static_cast<int64_t>(num_pairs) -
+            static_cast<int64_t>(2 * num_d);
+        return static_cast<double>(numerator) /
+            static_cast<double>(num_pairs);
+    }
+
+    double num_d = 0.0;
+    {
+        WDM_PROFILE_SCOPE("merge_sort", y.size());
+        utils::merge_sort(y, weights, num_d);
+    }
+    return ktau_from_counts(utils::perm_sum(weights, 2), num_d, 0.0, 0.0, 0.0);
+}
+
+//! calculates the (weighted) Kendall's tau using hints on the data.
+//! @param x, y input data.
+//! @param weights vector of weights for the data; can be empty.
+//! @param hints properties of the data.
+inline double ktau(std::vector<double> x,
+                   std::vector<double> y,
+                   std::vector<double> weights,
+                   const Data_hints& hints)
+{
+    if (x.size() <= small_n_max)
+        return ktau(x, y, weights);
+    WDM_PROFILE_SCOPE("ktau", x.size());
+
+    if (hints.ranked) {
+        // x order is found by placing each observation at its rank
+        std::vector<double> ys(y.size()), ws(weights.size());
+        for (size_t i = 0; i < x.size(); i++) {
+            size_t r = static_cast<size_t>(x[i]) - 1;
+            ys[r] = y[i];
+            if (weights.size() > 0)
+                ws[r] = weights[i];
+        }
+        return ktau_sorted_no_ties(ys, ws);
+    }
+    if (hints.sorted && hints.no_ties)
+        return ktau_sorted_no_ties(y, weights);
+    if (hints.sorted) {
+        // only ties in x need to be broken according to y
+        WDM_PROFILE_SCOPE("sort", x.size());
+        std::vector<size_t> idx;
+        for (size_t i = 0, reps; i < x.size(); i += reps) {
+            for (reps = 1; (i + reps < x.size()) && (x[i + reps] == x[i]); reps++) {}
+            if (reps == 1)
+                continue;
+            idx.resize(reps);
+            std::iota(idx.begin(), idx.end(), i);
+            std::sort(idx.begin(), idx.end(),
+                      [&y] (size_t a, size_t b) { return y[a] < y[b]; });
+            auto ys = utils::permute(y, idx);
+            std::copy(ys.begin(), ys.end(), y.begin() + i);
+            if (weights.size() > 0) {
+                auto ws = utils::permute(weights, idx);
+                std::copy(ws.begin(), ws.end(), weights.begin() + i);
+            }
+        }
+    } else {
+        utils::sort_all(x, y, weights);
+    }
+    if (hints.no_ties)
+        return ktau_sorted_no_ties(y, weights);
+    return ktau_sorted(x, y, weights);
+}
+
+//! calculates the (weighted) Spearman's rho using hints on the data.
+//! @param x, y input data.
+//! @param weights vector of weights for the data; can be empty.
+//! @param hints properties of the data.
+inline double srho(std::vector<double> x,
+                   std::vector<double> y,
+                   std::vector<double> weights,
+                   const Data_hints& hints)
+{
+    if (x.size() <= small_n_max)
+        return srho(x, y, weights);
+    WDM_PROFILE_SCOPE("srho", x.size());
+
+    // unweighted ranks are the data themselves (up to a shift)
+    if (hints.ranked && (weights.size() == 0))
+        return prho(x, y);
+    if (hints.sorted) {
+        std::vector<size_t> identity(x.size());
+        std::iota(identity.begin(), identity.end(), 0);
+        x = rank0_from_order(x, identity, weights, "average");
+    } else {
+        x = rank0(x, weights, "average");
+    }
+    y = rank0(y, weights, "average");
+    return prho(x, y, weights);
+}
+
+//! calculates the (weighted) Blomqvist's beta using hints on the data.
+//! @param x, y input data.
+//! @param weights vector of weights for the data; can be empty.
+//! @param hints properties of the data.
+inline double bbeta(const std::vector<double>& x,
+                    const std::vector<double>& y,
+                    const std::vector<double>& weights,
+                    const Data_hints& hints)
+{
+    WDM_PROFILE_SCOPE("bbeta", x.size());
+    double med_x, med_y;
+    if (hints.ranked && (weights.size() == 0)) {
+        med_x = med_y = (x.size() + 1) / 2.0;
+    } else {
+        med_x = hints.sorted ? median_sorted(x, weights) : median(x, weights);
+        med_y = median(y, weights);
+    }
+    return bbeta_from_medians(x, y, weights, med_x, med_y);
+}
+
+}
+
+}
@@ -16,6 +16,78 @@ namespace impl {
 
 const double pi = std::acos(-1);
 
+//! calculates the weighted Hoeffdings's D from (weighted) ranks.
+//! @tparam W the weight policy (see `utils::Weighted`).
+//! @param R_X, R_Y, S_X, S_Y univariate ranks of x and y with weights and
+//!   squared weights.
+//! @param R_XY, S_XY, T_XY, U_XY bivariate ranks with weights to the powers
+//!   1 to 4.
+//! @param weights pointer to the weights; only read if `W` is
+//!   `utils::Weighted`.
+//! @param sums power sums of the weights up to order 5 (see
+//!   `utils::power_sums()`).
+template<class W>
+double hoeffd_from_ranks(const std::vector<double>& R_X,
+                         const std::vector<double>& R_Y,
+                         const std::vector<double>& S_X,
+                         const std::vector<double>& S_Y,
+                         const std::vector<double>& R_XY,
+                         const std::vector<double>& S_XY,
+                         const std::vector<double>& T_XY,
+                         const std::vector<double>& U_XY,
+                         const double* weights,
+                         const std::vector<double>& sums)
+{
+    double A_1 = 0.0, A_2 = 0.0, A_3 = 0.0;
+    for (size_t i = 0; i < R_X.size(); i++) {
+        double w = W::get(weights, i);
+        A_1 += (R_XY[i] * R_XY[i] - S_XY[i]) * w;
+        A_2 += (
+            (R_X[i] * R_Y[i] - S_XY[i]) * R_XY[i] -
+                S_XY[i] * (R_X[i] + R_Y[i]) + 2 * T_XY[i]
+        ) * w;
+        A_3 += (
+            (R_X[i] * R_X[i] - S_X[i]) * (R_Y[i] * R_Y[i] - S_Y[i])  -
+                4 * ((R_X[i] * R_Y[i] - S_XY[i]) * S_XY[i] -
+                T_XY[i] * (R_X[i] + R_Y[i]) + 2 * U_XY[i]) -
+                2 * (S_XY[i] * S_XY[i] - U_XY[i])
+        ) * w;
+    }
+    double D = 0.0;
+    D += A_1 / (utils::perm_sum_from_power_sums(sums, 3) * 6);
+    D -= 2 * A_2 / (utils::perm_sum_from_power_sums(sums, 4) * 24);
+    D += A_3 / (utils::perm_sum_from_power_sums(sums, 5) * 120);
+
+    return 30.0 * D;
+}
+
+//! calculates the weighted Hoeffdings's D from (weighted) ranks.
+//! @param R_X, R_Y, S_X, S_Y univariate ranks of x and y with weights and
+//!   squared weights.
+//! @param R_XY, S_XY, T_XY, U_XY bivariate ranks with weights to the powers
+//!   1 to 4.
+//! @param weights vector of weights for the data; can be empty.
+//! @param sums power sums of the weights up to order 5 (see
+//!   `utils::power_sums()`).
+inline double hoeffd_from_ranks(const std::vector<double>& R_X,
+                                const std::vector<double>& R_Y,
+                                const std::vector<double>& S_X,
+                                const std::vector<double>& S_Y,
+                                const std::vector<double>& R_XY,
+                                const std::vector<double>& S_XY,
+                                const std::vector<double>& T_XY,
+                                const std::vector<double>& U_XY,
+                                const std::vector<double>& weights,
+                                const std::vector<double>& sums)
+{
+    if (weights.size() > 0) {
+        return hoeffd_from_ranks<utils::Weighted>(
+            R_X, R_Y, S_X, S_Y, R_XY, S_XY, T_XY, U_XY, weights.data(), sums);
+    }
+    return hoeffd_from_ranks<utils::Unweighted>(
+        R_X, R_Y, S_X, S_Y, R_XY, S_XY, T_XY, U_XY, nullptr, sums);
+}
+
 //! fast calculation of the weighted Hoeffdings's D.
 //! @param x, y input data.
 //! @param weights an optional vector of weights for the data.
@@ -23,22 +95,25 @@ inline double hoeffd(std::vector<double> x,
                      std::vector<double> y,
                      std::vector<double> weights = std::vector<double>())
 {
+    WDM_PROFILE_SCOPE("hoeffd", x.size());
     utils::check_sizes(x, y, weights);
 
-    // 1. Compute (weighted) ranks
-    std::vector<double> R_X = rank0(x, weights);
-    std::vector<double> R_Y = rank0(y, weights);
+    // 1. Compute (weighted) ranks; ties count by one half
+    std::vector<size_t> order_x = utils::get_order(x);
+    std::vector<size_t> order_y = utils::get_order(y);
+    std::vector<double> R_X = mid_rank0_from_order(x, order_x, weights);
+    std::vector<double> R_Y = mid_rank0_from_order(y, order_y, weights);
     std::vector<double> S_X, S_Y;
     if (weights.size() > 0) {
-        S_X = rank0(x, utils::pow(weights, 2));
-        S_Y = rank0(y, utils::pow(weights, 2));
+        S_X = mid_rank0_from_order(x, order_x, utils::pow(weights, 2));
+        S_Y = mid_rank0_from_order(y, order_y, utils::pow(weights, 2));
     } else {
         S_X = R_X;
         S_Y = R_Y;
     }
 
     // 2. Compute (weighted) bivariate ranks (number of points w/ both columns
-    // less than the ith row).
+    // less than the ith row; ties count by one half or one quarter).
     std::vector<double> R_XY, S_XY, T_XY, U_XY;
     R_XY = bivariate_rank(x, y, weights);
     if (weights.size() > 0) {
@@ -51,30 +126,16 @@ inline double hoeffd(std::vector<double> x,
         U_XY = R_XY;
     }
 
-
     // 3. Compute (weighted) Hoeffdings' D
-    if (weights.size() == 0)
-        weights = std::vector<double>(x.size(), 1.0);
-    double A_1 = 0.0, A_2 = 0.0, A_3 = 0.0;
-    for (size_t i = 0; i < x.size(); i++) {
-        A_1 += (R_XY[i] * R_XY[i] - S_XY[i]) * weights[i];
-        A_2 += (
-            (R_X[i] * R_Y[i] - S_XY[i]) * R_XY[i] -
-                S_XY[i] * (R_X[i] + R_Y[i]) + 2 * T_XY[i]
-        ) * weights[i];
-        A_3 += (
-            (R_X[i] * R_X[i] - S_X[i]) * (R_Y[i] * R_Y[i] - S_Y[i])  -
-                4 * ((R_X[i] * R_Y[i] - S_XY[i]) * S_XY[i] -
-                T_XY[i] * (R_X[i] + R_Y[i]) + 2 * U_XY[i]) -
-                2 * (S_XY[i] * S_XY[i] - U_XY[i])
-        ) * weights[i];
+    std::vector<double> sums;
+    if (weights.size() == 0) {
+        sums = utils::unit_power_sums(x.size(), 5);
+    } else {
+        sums = utils::power_sums(weights, 5);
     }
-    double D = 0.0;
-    D += A_1 / (utils::perm_sum(weights, 3) * 6);
-    D -= 2 * A_2 / (utils::perm_sum(weights, 4) * 24);
-    D += A_3 / (utils::perm_sum(weights, 5) * 120);
 
-    return 30.0 * D;
+    return hoeffd_from_ranks(R_X, R_Y, S_X, S_Y, R_XY, S_XY, T_XY, U_XY,
+                             weights, sums);
 }
 
 //! calculates the (approximate) asymptotic distribution function of Hoeffding's
@@ -91,7 +152,9 @@ inline double phoeffb(double B, double n) {
         p = std::min(1.0, std::exp(0.3885037 - 1.164879 * B));
         p = std::max(1e-12, p);
     } else {
-        std::vector<double> grid{
+        // tables are constant-initialized, so that lookups neither allocate
+        // nor synchronize
+        static const double grid[] = {
             1.1, 1.15, 1.2, 1.25, 1.3, 1.35, 1.4, 1.45, 1.5, 1.55, 1.6,
             1.65, 1.7, 1.75, 1.8, 1.85, 1.9, 1.95, 2, 2.05, 2.1, 2.15, 2.2,
             2.25, 2.3, 2.35, 2.4, 2.45, 2.5, 2.55, 2.6, 2.65, 2.7, 2.75,
@@ -101,7 +164,7 @@ inline double phoeffb(double B, double n) {
             4.6, 4.65, 4.7, 4.75, 4.8, 4.85, 4.9, 4.95, 5, 5.5, 6, 6.5, 7,
             7.5, 8, 8.5
         };
-        std::vector<double> vals{
+        static const double vals[] = {
             0.5297, 0.4918, 0.4565, 0.4236, 0.3930, 0.3648, 0.3387, 0.3146,
             0.2924, 0.2719, 0.2530, 0.2355, 0.2194, 0.2045, 0.1908, 0.1781,
             0.1663, 0.1554, 0.1453, 0.1359, 0.1273, 0.1192, 0.1117, 0.1047,
@@ -111,10 +174,10 @@ inline double phoeffb(double B, double n) {
             0.0230, 0.0217, 0.0205, 0.0194, 0.0183, 0.0173, 0.0163, 0.0154,
             0.0145, 0.0137, 0.0130, 0.0123, 0.0116, 0.0110, 0.0104, 0.0098,
             0.0093, 0.0087, 0.0083, 0.0078, 0.0074, 0.0070, 0.0066, 0.0063,
-            0.0059, 0.0056, 0.0053, 0.0050, 0.0047, 0.0045, 0.0042, 0.00025,
-            0.00014, 0.0008, 0.0005, 0.0003, 0.0002, 0.0001
+            0.0059, 0.0056, 0.0053, 0.0050, 0.0047, 0.0045, 0.0042, 0.0025,
+            0.0014, 0.0008, 0.0005, 0.0003, 0.0002, 0.0001
         };
-        p = utils::linear_interp(B, grid, vals);
+        p = utils::linear_interp(B, grid, vals, sizeof(grid) / sizeof(grid[0]));
     }
 
     return p;
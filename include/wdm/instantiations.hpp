@@ -0,0 +1,79 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+//! the kernels that are instantiated for both weight policies
+//! (`utils::Weighted` and `utils::Unweighted`).
+//!
+//! With `PREFIX` set to `template`, the macro expands to explicit
+//! instantiation definitions (used by the compiled libraries); with
+//! `extern template`, to declarations that keep translation units linking a
+//! compiled library from instantiating the kernels themselves.
+#define WDM_KERNEL_INSTANTIATIONS(PREFIX, W)                                   \
+    PREFIX double utils::count_ties_v<W>(const std::vector<double>&,          \
+                                         const double*);                      \
+    PREFIX double utils::count_tied_pairs<W>(const std::vector<double>&,      \
+                                             const double*);                  \
+    PREFIX double utils::count_tied_triplets<W>(const std::vector<double>&,   \
+                                                const double*);               \
+    PREFIX double utils::count_joint_ties<W>(const std::vector<double>&,      \
+                                             const std::vector<double>&,      \
+                                             const double*);                  \
+    PREFIX void utils::merge<W>(std::vector<double>&,                         \
+                                const std::vector<double>&,                   \
+                                const std::vector<double>&,                   \
+                                std::vector<double>&,                         \
+                                const std::vector<double>&,                   \
+                                const std::vector<double>&,                   \
+                                double&);                                     \
+    PREFIX void utils::merge_sort<W>(std::vector<double>&,                    \
+                                     std::vector<double>&,                    \
+                                     double&);                                \
+    PREFIX void utils::merge_count_per_element<W>(std::vector<double>&,       \
+                                                  const std::vector<double>&, \
+                                                  const std::vector<double>&, \
+                                                  std::vector<double>&,       \
+                                                  const std::vector<double>&, \
+                                                  const std::vector<double>&, \
+                                                  std::vector<double>&,       \
+                                                  const std::vector<double>&, \
+                                                  const std::vector<double>&);\
+    PREFIX void utils::merge_sort_count_per_element<W>(std::vector<double>&,  \
+                                                       std::vector<double>&,  \
+                                                       std::vector<double>&); \
+    PREFIX double impl::prho_raw<W>(const double*, const double*,             \
+                                    const double*, size_t);                   \
+    PREFIX double impl::bbeta_from_medians<W>(const std::vector<double>&,     \
+                                              const std::vector<double>&,     \
+                                              const double*, double, double); \
+    PREFIX double impl::hoeffd_from_ranks<W>(const std::vector<double>&,      \
+                                             const std::vector<double>&,      \
+                                             const std::vector<double>&,      \
+                                             const std::vector<double>&,      \
+                                             const std::vector<double>&,      \
+                                             const std::vector<double>&,      \
+                                             const std::vector<double>&,      \
+                                             const std::vector<double>&,      \
+                                             const double*,                   \
+                                             const std::vector<double>&);     \
+    PREFIX void impl::assign_rank0<W>(std::vector<double>&,                   \
+                                      const std::vector<size_t>&,             \
+                                      const double*, bool);                   \
+    PREFIX std::vector<double> impl::bivariate_rank_lanes<W>(                 \
+        const std::vector<double>&, const std::vector<size_t>&,               \
+        const std::vector<size_t>&, const std::vector<double>&, size_t,       \
+        size_t);
+
+// translation units using the headers together with a compiled library
+// (`WDM_COMPILED` is set by the CMake targets `wdm_static` and `wdm_shared`)
+// link against its instantiations
+#if defined(WDM_COMPILED) && !defined(WDM_LIB_BUILDING)
+namespace wdm {
+WDM_KERNEL_INSTANTIATIONS(extern template, utils::Weighted)
+WDM_KERNEL_INSTANTIATIONS(extern template, utils::Unweighted)
+}
+#endif
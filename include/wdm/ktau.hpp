@@ -7,6 +7,7 @@
 #pragma once
 
 #include "utils.hpp"
+#include "small.hpp"
 
 namespace wdm {
 
@@ -21,38 +22,187 @@ inline void normalize_weights(std::vector<double>& w)
     }
 }
 
-//! fast calculation of the weighted Kendall's tau.
-//! @param x, y input data.
-//! @param weights an optional vector of weights for the data.
-inline double ktau(std::vector<double> x,
-                   std::vector<double> y,
-                   std::vector<double> weights = std::vector<double>())
+//! calculates Kendall's tau from (weighted) pair counts.
+//! @param num_pairs the (weighted) number of pairs.
+//! @param num_d the (weighted) number of discordant pairs.
+//! @param ties_x, ties_y, ties_both the (weighted) number of pairs tied in
+//!   `x`, in `y`, and in both.
+inline double ktau_from_counts(double num_pairs,
+                               double num_d,
+                               double ties_x,
+                               double ties_y,
+                               double ties_both)
 {
-    utils::check_sizes(x, y, weights);
+    double num_c = num_pairs - (num_d + ties_x + ties_y - ties_both);
+    double tau = num_c - num_d;
+    tau /= std::sqrt((num_pairs - ties_x) * (num_pairs - ties_y));
 
-    // 1.1 Sort x, y, and weights in x order; break ties in according to y.
-    utils::sort_all(x, y, weights);
+    return tau;
+}
+
+//! calculates Kendall's tau from exact (unweighted) pair counts.
+//! @param num_pairs the number of pairs.
+//! @param num_d the number of discordant pairs.
+//! @param ties_x, ties_y, ties_both the number of pairs tied in `x`, in `y`,
+//!   and in both.
+inline double ktau_from_exact_counts(uint64_t num_pairs,
+                                     uint64_t num_d,
+                                     uint64_t ties_x,
+                                     uint64_t ties_y,
+                                     uint64_t ties_both)
+{
+    // the numerator is num_c - num_d
+    int64_t numerator = static_cast<int64_t>(num_pairs + ties_both) -
+        static_cast<int64_t>(ties_x + ties_y + 2 * num_d);
+
+    return static_cast<double>(numerator) /
+        std::sqrt(static_cast<double>(num_pairs - ties_x) *
+                  static_cast<double>(num_pairs - ties_y));
+}
+
+//! calculates Kendall's tau from data in x order using exact integer counts.
+//!
+//! Counts are exact as long as the number of pairs fits into a 63-bit
+//! integer (about \f$ n < 4 \cdot 10^9 \f$ observations).
+//!
+//! @param x, y input data, sorted in x order with ties broken according to
+//!   y; on exit, `y` is sorted.
+inline double ktau_sorted_unweighted(const std::vector<double>& x,
+                                     std::vector<double>& y)
+{
+    // 1. Count pairs of tied x and simultaneous ties in x and y.
+    uint64_t ties_x = utils::count_tied_pairs_exact(x);
+    uint64_t ties_both = utils::count_joint_ties_exact(x, y);
 
-    // 1.2 Count pairs of tied x and simultaneous ties in x and y.
+    // 2.1 Sort y again and count exchanges (= number of discordant pairs).
+    uint64_t num_d;
+    {
+        WDM_PROFILE_SCOPE("merge_sort", y.size());
+        num_d = utils::count_inversions(y);
+    }
+
+    // 2.2 Count pairs of tied y.
+    uint64_t ties_y = utils::count_tied_pairs_exact(y);
+
+    // 3. Calculate Kendall's tau.
+    uint64_t n = x.size();
+    return ktau_from_exact_counts(n * (n - 1) / 2, num_d, ties_x, ties_y,
+                                  ties_both);
+}
+
+//! calculates the weighted Kendall's tau from data in x order.
+//! @param x, y, weights input data, sorted in x order with ties broken
+//!   according to y; on exit, `y` and `weights` are sorted in y order.
+inline double ktau_sorted(const std::vector<double>& x,
+                          std::vector<double>& y,
+                          std::vector<double>& weights)
+{
+    if (weights.size() == 0)
+        return ktau_sorted_unweighted(x, y);
+
+    // 1. Count pairs of tied x and simultaneous ties in x and y.
     double ties_x = utils::count_tied_pairs(x, weights);
     double ties_both = utils::count_joint_ties(x, y, weights);
 
     // 2.1 Sort y again and count exchanges (= number of discordant pairs).
     double num_d = 0.0;
-    utils::merge_sort(y, weights, num_d);
+    {
+        WDM_PROFILE_SCOPE("merge_sort", y.size());
+        utils::merge_sort(y, weights, num_d);
+    }
 
     // 2.2 Count pairs of tied y.
     double ties_y = utils::count_tied_pairs(y, weights);
 
     // 3. Calculate Kendall's tau.
-    if (weights.size() == 0)
-        weights = std::vector<double>(x.size(), 1.0);
     double num_pairs = utils::perm_sum(weights, 2);
-    double num_c = num_pairs - (num_d + ties_x + ties_y - ties_both);
-    double tau = num_c - num_d;
-    tau /= std::sqrt((num_pairs - ties_x) * (num_pairs - ties_y));
 
-    return tau;
+    return ktau_from_counts(num_pairs, num_d, ties_x, ties_y, ties_both);
+}
+
+//! fast calculation of the weighted Kendall's tau.
+//! @param x, y input data.
+//! @param weights an optional vector of weights for the data.
+inline double ktau(std::vector<double> x,
+                   std::vector<double> y,
+                   std::vector<double> weights = std::vector<double>())
+{
+    WDM_PROFILE_SCOPE("ktau", x.size());
+    utils::check_sizes(x, y, weights);
+    if (x.size() <= small_n_max) {
+        return ktau_small(x.data(), y.data(),
+                          weights.size() > 0 ? weights.data() : nullptr,
+                          x.size());
+    }
+
+    // Sort x, y, and weights in x order; break ties in according to y.
+    utils::sort_all(x, y, weights);
+
+    return ktau_sorted(x, y, weights);
+}
+
+//! (weighted) numbers of tied pairs and triplets of a variable entering the
+//! tie adjustment for Kendall's test statistic.
+struct Tie_profile {
+    double pairs;
+    double triplets;
+    double v;
+};
+
+//! computes the tie profile of a variable.
+//! @param x, weights input data and weights, sorted in x order.
+inline Tie_profile tie_profile_sorted(const std::vector<double>& x,
+                                      const std::vector<double>& weights)
+{
+    return {utils::count_tied_pairs(x, weights),
+            utils::count_tied_triplets(x, weights),
+            utils::count_ties_v(x, weights)};
+}
+
+//! tie adjustment for Kendall's test statistic from the tie profiles of both
+//! variables.
+//! @param ties_x, ties_y the tie profiles.
+//! @param sums power sums of the weights up to order 3 (see
+//!   `utils::power_sums()`).
+inline double ktau_stat_adjust_from_ties(const Tie_profile& ties_x,
+                                         const Tie_profile& ties_y,
+                                         const std::vector<double>& sums)
+{
+    double s = sums[1];
+    double s2 = utils::perm_sum_from_power_sums(sums, 2);
+    double s3 = utils::perm_sum_from_power_sums(sums, 3);
+    double r = s / sums[2];
+    double v_0 = 2 * s2 * (2 * s) * std::pow(r, 3);
+    double v_1 = 2 * ties_x.pairs * 2 * ties_y.pairs / (2 * 2 * s2) *
+        std::pow(r, 2);
+    double v_2 = 6 * ties_x.triplets * 6 * ties_y.triplets / (9 * 6 * s3) *
+        std::pow(r, 3);
+    double v = (v_0 - std::pow(r, 3) * (ties_x.v + ties_y.v)) / 18 + (v_1 + v_2);
+    return std::pow(r, 2) *
+        std::sqrt((s2 - ties_x.pairs) * (s2 - ties_y.pairs) / v);
+}
+
+//! tie adjustment for Kendall's test statistic from data sorted in x order
+//! and in y order.
+//! @param x, weights_x input data and weights, sorted in x order.
+//! @param y, weights_y input data and weights, sorted in y order.
+inline double ktau_stat_adjust_sorted(const std::vector<double>& x,
+                                      const std::vector<double>& weights_x,
+                                      const std::vector<double>& y,
+                                      const std::vector<double>& weights_y)
+{
+    // 1. Count pairs and triplets of tied x and y.
+    Tie_profile ties_x = tie_profile_sorted(x, weights_x);
+    Tie_profile ties_y = tie_profile_sorted(y, weights_y);
+
+    // 2. Calculate adjustment factor.
+    std::vector<double> sums;
+    if (weights_y.size() == 0) {
+        sums = utils::unit_power_sums(y.size(), 3);
+    } else {
+        sums = utils::power_sums(weights_y, 3);
+    }
+    return ktau_stat_adjust_from_ties(ties_x, ties_y, sums);
 }
 
 //! tie adjustment for Kendall's test statistic
@@ -63,34 +213,80 @@ inline double ktau_stat_adjust(
 {
     utils::check_sizes(x, y, weights);
 
-    // 1.1 Sort x, y, and weights in x order; break ties in according to y.
+    // Sort x, y, and weights in x order; break ties in according to y.
     utils::sort_all(x, y, weights);
+    std::vector<double> x_sorted = x, weights_x = weights;
 
-    // 1.2 Count pairs and triplets of tied x and simultaneous ties in x and y.
-    double pair_x = utils::count_tied_pairs(x, weights);
-    double trip_x = utils::count_tied_triplets(x, weights);
-    double v_x = utils::count_ties_v(x, weights);
-
-    // 2.1 Sort y and weights in y order; break ties according to x.
+    // Sort y and weights in y order; break ties according to x.
     utils::sort_all(y, x, weights);
 
-    // 2.2 Count pairs and triplets of tied y.
-    double pair_y = utils::count_tied_pairs(y, weights);
-    double trip_y = utils::count_tied_triplets(y, weights);
-    double v_y = utils::count_ties_v(y, weights);
+    return ktau_stat_adjust_sorted(x_sorted, weights_x, y, weights);
+}
 
-    // 3. Calculate adjustment factor.
-    if (weights.size() == 0)
-        weights = std::vector<double>(x.size(), 1.0);
-    double s = utils::sum(weights);
-    double s2 = utils::perm_sum(weights, 2);
-    double s3 = utils::perm_sum(weights, 3);
-    double r = s / utils::sum(utils::pow(weights, 2));
-    double v_0 = 2 * s2 * (2 * s) * std::pow(r, 3);
-    double v_1 = 2 * pair_x * 2 * pair_y / (2 * 2 * s2) * std::pow(r, 2);
-    double v_2 = 6 * trip_x * 6 * trip_y / (9 * 6 * s3) * std::pow(r, 3);
-    double v = (v_0 - std::pow(r, 3) * (v_x - v_y)) / 18 + (v_1 + v_2);
-    return std::pow(r, 2) * std::sqrt((s2 - pair_x) * (s2 - pair_y) / v);
+//! largest sample size for which `Indep_test` uses the exact null
+//! distribution of the unweighted Kendall's tau (without ties).
+const size_t ktau_exact_n_max = 50;
+
+//! cumulative null distributions of the number of discordant pairs.
+//!
+//! Element `n` holds \f$ P(I \le k) \f$, \f$ k = 0, \dots, n(n - 1) / 2 \f$,
+//! for the number \f$ I \f$ of inversions of a random permutation of size
+//! \f$ n \le \f$ `ktau_exact_n_max`. The probabilities follow from the
+//! recursion \f$ p_n(k) = \sum_{j = 0}^{n - 1} p_{n - 1}(k - j) / n \f$ (the
+//! last element adds between 0 and \f$ n - 1 \f$ inversions), evaluated with
+//! a sliding window. The tables are built once, on first use; initialization
+//! of the static is thread-safe.
+inline const std::vector<std::vector<double>>& ktau_null_table()
+{
+    static const std::vector<std::vector<double>> table = [] {
+        std::vector<std::vector<double>> cdf(ktau_exact_n_max + 1);
+        std::vector<double> p(1, 1.0), p_new;
+        cdf[0] = cdf[1] = p;
+        for (size_t n = 2; n <= ktau_exact_n_max; n++) {
+            size_t num_pairs = n * (n - 1) / 2;
+            p_new.assign(num_pairs + 1, 0.0);
+            double window = 0.0;
+            for (size_t k = 0; k <= num_pairs; k++) {
+                if (k < p.size())
+                    window += p[k];
+                if ((k >= n) && (k - n < p.size()))
+                    window -= p[k - n];
+                p_new[k] = window / static_cast<double>(n);
+            }
+            p.swap(p_new);
+            cdf[n].resize(num_pairs + 1);
+            std::partial_sum(p.begin(), p.end(), cdf[n].begin());
+        }
+        return cdf;
+    }();
+
+    return table;
+}
+
+//! computes the exact p-value of the test based on the unweighted Kendall's
+//! tau for data without ties.
+//! @param tau the estimate.
+//! @param n the sample size (at most `ktau_exact_n_max`).
+//! @param alternative `"two-sided"`, `"greater"`, or `"less"`.
+inline double pktau_exact(double tau, size_t n, const std::string& alternative)
+{
+    const auto& cdf = ktau_null_table().at(n);
+    size_t num_pairs = cdf.size() - 1;
+    double num_d = std::round((1 - tau) * static_cast<double>(num_pairs) / 2);
+    size_t k = static_cast<size_t>(
+        std::min(std::max(num_d, 0.0), static_cast<double>(num_pairs)));
+
+    // the distribution is symmetric: P(I >= k) = P(I <= num_pairs - k)
+    double p_greater = cdf[k];
+    double p_less = cdf[num_pairs - k];
+    if (alternative == "two-sided") {
+        return std::min(1.0, 2 * std::min(p_greater, p_less));
+    } else if (alternative == "greater") {
+        return p_greater;
+    } else if (alternative == "less") {
+        return p_less;
+    }
+    throw std::runtime_error("alternative not implemented.");
 }
 
 }
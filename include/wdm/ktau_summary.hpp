@@ -0,0 +1,257 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "ktau.hpp"
+#include "nan_handling.hpp"
+#include <cstdint>
+#include <cstring>
+
+namespace wdm {
+
+//! Mergeable summary for Kendall's tau
+//!
+//! The summary of a (shard of the) data holds the observations sorted in x
+//! order (ties broken by y) together with the (weighted) numbers of
+//! discordant and tied pairs. Summaries of disjoint shards can be merged,
+//! counting the discordant and tied pairs across shards while merging the
+//! sorted runs, and serialized to a compact binary format, so that Kendall's
+//! \f$ \tau \f$ of the full data can be computed in a reduce tree.
+//!
+//! @details
+//! Observations containing a `nan` are removed. The result of merging does
+//! not depend on the order of merges up to rounding errors in the weighted
+//! case.
+class Ktau_summary {
+public:
+    //! constructs an empty summary.
+    Ktau_summary() :
+        num_d_(0.0), ties_x_(0.0), ties_y_(0.0), ties_both_(0.0),
+        s1_(0.0), s2_(0.0)
+    {}
+
+    //! constructs the summary of a shard of the data.
+    //! @param x, y input data.
+    //! @param weights an optional vector of weights for the data.
+    Ktau_summary(std::vector<double> x,
+                 std::vector<double> y,
+                 std::vector<double> weights = std::vector<double>())
+    {
+        utils::check_sizes(x, y, weights);
+        utils::remove_incomplete(x, y, weights);
+
+        // Sort x, y, and weights in x order; break ties in according to y.
+        utils::sort_all(x, y, weights);
+        ties_x_ = utils::count_tied_pairs(x, weights);
+        ties_both_ = utils::count_joint_ties(x, y, weights);
+        x_ = x;
+        y_ = y;
+        w_ = weights;
+
+        // Sort y again and count exchanges (= number of discordant pairs).
+        num_d_ = 0.0;
+        utils::merge_sort(y, weights, num_d_);
+        ties_y_ = utils::count_tied_pairs(y, weights);
+
+        s1_ = static_cast<double>(x.size());
+        s2_ = s1_;
+        if (w_.size() > 0) {
+            auto sums = utils::power_sums(w_, 2);
+            s1_ = sums[1];
+            s2_ = sums[2];
+        }
+    }
+
+    //! the number of observations in the summary.
+    size_t size() const { return x_.size(); }
+
+    //! Kendall's \f$ \tau \f$ of the data in the summary; `nan` for less
+    //! than two observations.
+    double tau() const
+    {
+        if (x_.size() < 2)
+            return std::numeric_limits<double>::quiet_NaN();
+        return impl::ktau_from_counts((s1_ * s1_ - s2_) / 2, num_d_,
+                                      ties_x_, ties_y_, ties_both_);
+    }
+
+    //! merges the summary of another (disjoint) shard into this one.
+    void merge(const Ktau_summary& other)
+    {
+        size_t na = x_.size(), nb = other.x_.size(), n = na + nb;
+        bool weighted = (w_.size() > 0) || (other.w_.size() > 0);
+        auto weight = [] (const std::vector<double>& w, size_t i) {
+            return (w.size() > 0) ? w[i] : 1.0;
+        };
+
+        // merge the runs in x order, remembering where observations come from
+        std::vector<double> x(n), y(n), w(weighted ? n : 0);
+        std::vector<size_t> part(n);
+        for (size_t i = 0, j = 0, k = 0; k < n; k++) {
+            bool take_a = (j == nb) ||
+                ((i < na) && ((x_[i] < other.x_[j]) ||
+                              ((x_[i] == other.x_[j]) && (y_[i] <= other.y_[j]))));
+            if (take_a) {
+                x[k] = x_[i];
+                y[k] = y_[i];
+                if (weighted)
+                    w[k] = weight(w_, i);
+                part[k] = 0;
+                i++;
+            } else {
+                x[k] = other.x_[j];
+                y[k] = other.y_[j];
+                if (weighted)
+                    w[k] = weight(other.w_, j);
+                part[k] = 1;
+                j++;
+            }
+        }
+
+        // An observation is discordant with all observations of the other
+        // part that precede it in x order and have a larger y (ties in x are
+        // sorted by y). Ties across parts are collected per group.
+        auto ranks_y = utils::dense_ranks(y, utils::get_order(y));
+        size_t max_rank = (n > 0) ? *std::max_element(ranks_y.begin(),
+                                                      ranks_y.end()) : 0;
+        utils::Fenwick_tree tree(max_rank, 2);
+        std::vector<double> w_y(2 * (max_rank + 1), 0.0);
+        double total[2] = {0.0, 0.0}, below[2], group_x[2] = {0.0, 0.0},
+            group_xy[2] = {0.0, 0.0};
+        double cross_d = 0.0, cross_x = 0.0, cross_y = 0.0, cross_both = 0.0;
+        for (size_t k = 0; k < n; k++) {
+            size_t p = part[k];
+            double wk = weighted ? w[k] : 1.0;
+            if ((k == 0) || (x[k] != x[k - 1])) {
+                cross_x += group_x[0] * group_x[1];
+                group_x[0] = group_x[1] = 0.0;
+            }
+            if ((k == 0) || (x[k] != x[k - 1]) || (y[k] != y[k - 1])) {
+                cross_both += group_xy[0] * group_xy[1];
+                group_xy[0] = group_xy[1] = 0.0;
+            }
+            group_x[p] += wk;
+            group_xy[p] += wk;
+
+            tree.prefix_sum(ranks_y[k], below);
+            cross_d += wk * (total[1 - p] - below[1 - p]);
+            double added[2] = {0.0, 0.0};
+            added[p] = wk;
+            tree.add(ranks_y[k], added);
+            total[p] += wk;
+            w_y[2 * ranks_y[k] + p] += wk;
+        }
+        cross_x += group_x[0] * group_x[1];
+        cross_both += group_xy[0] * group_xy[1];
+        for (size_t r = 1; r <= max_rank; r++)
+            cross_y += w_y[2 * r] * w_y[2 * r + 1];
+
+        num_d_ += other.num_d_ + cross_d;
+        ties_x_ += other.ties_x_ + cross_x;
+        ties_y_ += other.ties_y_ + cross_y;
+        ties_both_ += other.ties_both_ + cross_both;
+        s1_ += other.s1_;
+        s2_ += other.s2_;
+        x_.swap(x);
+        y_.swap(y);
+        w_.swap(w);
+    }
+
+    //! serializes the summary to a binary format (in native byte order).
+    std::vector<char> serialize() const
+    {
+        std::vector<char> bytes;
+        uint32_t header[4] = {magic, byte_order, version,
+                              static_cast<uint32_t>(w_.size() > 0)};
+        uint64_t n = x_.size();
+        double counts[6] = {num_d_, ties_x_, ties_y_, ties_both_, s1_, s2_};
+        append(bytes, header, 4);
+        append(bytes, &n, 1);
+        append(bytes, counts, 6);
+        append(bytes, x_.data(), x_.size());
+        append(bytes, y_.data(), y_.size());
+        append(bytes, w_.data(), w_.size());
+        return bytes;
+    }
+
+    //! reconstructs a summary from its serialization.
+    //! @param bytes the output of `serialize()`.
+    static Ktau_summary deserialize(const std::vector<char>& bytes)
+    {
+        size_t pos = 0;
+        uint32_t header[4];
+        uint64_t n;
+        double counts[6];
+        extract(bytes, pos, header, 4);
+        if (header[0] != magic)
+            throw std::runtime_error("not a serialized Kendall summary.");
+        if (header[1] != byte_order)
+            throw std::runtime_error("serialized with a different byte order.");
+        if (header[2] != version)
+            throw std::runtime_error("unsupported serialization version.");
+        extract(bytes, pos, &n, 1);
+        extract(bytes, pos, counts, 6);
+        if (n > bytes.size() / sizeof(double))
+            throw std::runtime_error("invalid size of serialized summary.");
+
+        Ktau_summary s;
+        s.x_.resize(n);
+        s.y_.resize(n);
+        s.w_.resize(header[3] ? n : 0);
+        extract(bytes, pos, s.x_.data(), s.x_.size());
+        extract(bytes, pos, s.y_.data(), s.y_.size());
+        extract(bytes, pos, s.w_.data(), s.w_.size());
+        if (pos != bytes.size())
+            throw std::runtime_error("invalid size of serialized summary.");
+        s.num_d_ = counts[0];
+        s.ties_x_ = counts[1];
+        s.ties_y_ = counts[2];
+        s.ties_both_ = counts[3];
+        s.s1_ = counts[4];
+        s.s2_ = counts[5];
+        return s;
+    }
+
+private:
+    static const uint32_t magic = 0x4b4d4457;  // "WDMK"
+    static const uint32_t byte_order = 0x01020304;
+    static const uint32_t version = 1;
+
+    template<class T>
+    static void append(std::vector<char>& bytes, const T* data, size_t n)
+    {
+        size_t pos = bytes.size();
+        bytes.resize(pos + n * sizeof(T));
+        if (n > 0)
+            std::memcpy(&bytes[pos], data, n * sizeof(T));
+    }
+
+    template<class T>
+    static void extract(const std::vector<char>& bytes,
+                        size_t& pos,
+                        T* data,
+                        size_t n)
+    {
+        if (n > (bytes.size() - pos) / sizeof(T))
+            throw std::runtime_error("invalid size of serialized summary.");
+        if (n > 0)
+            std::memcpy(data, &bytes[pos], n * sizeof(T));
+        pos += n * sizeof(T);
+    }
+
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<double> w_;
+    double num_d_;
+    double ties_x_;
+    double ties_y_;
+    double ties_both_;
+    double s1_;
+    double s2_;
+};
+
+}
@@ -0,0 +1,214 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "utils.hpp"
+#include "ranks.hpp"
+#include "ktau.hpp"
+#include "prho.hpp"
+#include "bbeta.hpp"
+#include "methods.hpp"
+#include "parallel.hpp"
+
+namespace wdm {
+
+namespace impl {
+
+//! ordering information of a time series shared across all lags.
+struct Lag_series {
+    std::vector<size_t> order;  //!< non-missing time points in ascending order.
+    std::vector<size_t> ranks;  //!< dense ranks (starting at 1); 0 if missing.
+};
+
+//! sorts and ranks a time series once.
+//! @param x input series.
+inline Lag_series lag_series(const std::vector<double>& x)
+{
+    Lag_series s;
+    for (size_t t = 0; t < x.size(); t++) {
+        if (!std::isnan(x[t]))
+            s.order.push_back(t);
+    }
+    std::sort(s.order.begin(), s.order.end(),
+              [&x] (size_t i, size_t j) { return x[i] < x[j]; });
+    s.ranks.assign(x.size(), 0);
+    size_t r = 0;
+    for (size_t k = 0; k < s.order.size(); k++) {
+        if ((k == 0) || (x[s.order[k]] != x[s.order[k - 1]]))
+            r++;
+        s.ranks[s.order[k]] = r;
+    }
+
+    return s;
+}
+
+//! calculates a dependence measure between `x[t]` and `y[t - lag]`.
+//!
+//! The subsample of a lag is extracted from the shared orderings in linear
+//! time; only Kendall's \f$ \tau \f$ needs to sort (the y ranks in x order).
+//! @param x, y input series.
+//! @param sx, sy ordering information of the series (see `lag_series()`).
+//! @param lag the lag.
+//! @param method the dependence measure.
+inline double wdm_lag(const std::vector<double>& x,
+                      const std::vector<double>& y,
+                      const Lag_series& sx,
+                      const Lag_series& sy,
+                      size_t lag,
+                      std::string method)
+{
+    size_t n = x.size();
+    auto complete = [&] (size_t t) {
+        return (t >= lag) && (t < n) && (sx.ranks[t] > 0) &&
+            (sy.ranks[t - lag] > 0);
+    };
+
+    // positions of the complete time points in the subsample
+    std::vector<size_t> pos(n, 0);
+    std::vector<double> x_sub, y_sub;
+    for (size_t t = lag; t < n; t++) {
+        if (complete(t)) {
+            pos[t] = x_sub.size();
+            x_sub.push_back(x[t]);
+            y_sub.push_back(y[t - lag]);
+        }
+    }
+    size_t m = x_sub.size();
+    if (m < methods::get_min_nobs(method))
+        return std::numeric_limits<double>::quiet_NaN();
+
+    if (methods::is_pearson(method))
+        return prho(x_sub, y_sub);
+
+    if (methods::is_kendall(method)) {
+        // dense ranks in x order; ties in x are broken according to y
+        std::vector<double> xs, ys;
+        xs.reserve(m);
+        ys.reserve(m);
+        for (size_t t : sx.order) {
+            if (complete(t)) {
+                xs.push_back(static_cast<double>(sx.ranks[t]));
+                ys.push_back(static_cast<double>(sy.ranks[t - lag]));
+            }
+        }
+        for (size_t i = 0, reps; i < m; i += reps) {
+            for (reps = 1; (i + reps < m) && (xs[i + reps] == xs[i]); reps++) {}
+            if (reps > 1)
+                std::sort(ys.begin() + i, ys.begin() + i + reps);
+        }
+        return ktau_sorted_unweighted(xs, ys);
+    }
+
+    if (methods::is_spearman(method)) {
+        // average ranks within the subsample from the shared orderings
+        auto sub_ranks = [&] (const Lag_series& s, size_t shift) {
+            std::vector<double> r(m);
+            std::vector<size_t> idx;
+            idx.reserve(m);
+            for (size_t u : s.order) {
+                if (complete(u + shift))
+                    idx.push_back(u + shift);
+            }
+            for (size_t i = 0, reps; i < m; i += reps) {
+                size_t rank = s.ranks[idx[i] - shift];
+                for (reps = 1; (i + reps < m) &&
+                     (s.ranks[idx[i + reps] - shift] == rank); reps++) {}
+                for (size_t k = 0; k < reps; k++)
+                    r[pos[idx[i + k]]] = static_cast<double>(i) + (reps - 1) / 2.0;
+            }
+            return r;
+        };
+        return prho(sub_ranks(sx, 0), sub_ranks(sy, lag));
+    }
+
+    if (methods::is_blomqvist(method)) {
+        std::vector<double> xs, ys;
+        xs.reserve(m);
+        ys.reserve(m);
+        for (size_t t : sx.order) {
+            if (complete(t))
+                xs.push_back(x[t]);
+        }
+        for (size_t u : sy.order) {
+            if (complete(u + lag))
+                ys.push_back(y[u]);
+        }
+        return bbeta_from_medians(x_sub, y_sub, std::vector<double>(),
+                                  median_sorted(xs, std::vector<double>()),
+                                  median_sorted(ys, std::vector<double>()));
+    }
+
+    throw std::runtime_error("method not implemented.");
+}
+
+}
+
+//! calculates a dependence measure between a time series and the lags of
+//! another (cross-correlogram).
+//!
+//! Each series is sorted and ranked only once; the subsample for each lag is
+//! extracted from the shared orderings in linear time. Lags are processed in
+//! parallel.
+//!
+//! @param x, y input series of the same length.
+//! @param max_lag the largest lag.
+//! @param method the dependence measure; one of `"pearson"`, `"spearman"`,
+//!    `"kendall"`, `"blomqvist"` (or their aliases, see `wdm()`).
+//! @param remove_missing if `true`, all pairs containing a `nan` are removed
+//!    (for each lag separately); otherwise throws an error if `nan`s are
+//!    present.
+//! @param num_threads number of threads; `0` (default) uses all available
+//!    cores.
+//!
+//! @return a vector whose element `k - 1` contains the dependence measure
+//!    between `x[t]` and `y[t - k]`, \f$ k = 1, \dots, \f$ `max_lag`; for
+//!    negative lags, swap `x` and `y`.
+inline std::vector<double> wdm_lags(const std::vector<double>& x,
+                                    const std::vector<double>& y,
+                                    size_t max_lag,
+                                    std::string method,
+                                    bool remove_missing = true,
+                                    size_t num_threads = 0)
+{
+    WDM_PROFILE_SCOPE("lags", x.size() * max_lag);
+    utils::check_sizes(x, y, std::vector<double>());
+    if (!methods::is_pearson(method) && !methods::is_spearman(method) &&
+        !methods::is_kendall(method) && !methods::is_blomqvist(method))
+        throw std::runtime_error("method not implemented.");
+    if (!remove_missing && (utils::any_nan(x) || utils::any_nan(y)))
+        throw std::runtime_error("there are missing values in the data; "
+                                 "try remove_missing = TRUE");
+
+    auto sx = impl::lag_series(x);
+    auto sy = (&x == &y) ? sx : impl::lag_series(y);
+    std::vector<double> res(max_lag);
+    utils::parallel_for(max_lag, num_threads, [&] (size_t k, size_t) {
+        res[k] = impl::wdm_lag(x, y, sx, sy, k + 1, method);
+    });
+
+    return res;
+}
+
+//! calculates a dependence measure between a time series and its own lags
+//! (autocorrelogram); see the cross version of `wdm_lags()` for details.
+//! @param x input series.
+//! @param max_lag the largest lag.
+//! @param method the dependence measure.
+//! @param remove_missing if `true`, all pairs containing a `nan` are removed;
+//!    otherwise throws an error if `nan`s are present.
+//! @param num_threads number of threads; `0` (default) uses all available
+//!    cores.
+inline std::vector<double> wdm_lags(const std::vector<double>& x,
+                                    size_t max_lag,
+                                    std::string method,
+                                    bool remove_missing = true,
+                                    size_t num_threads = 0)
+{
+    return wdm_lags(x, x, max_lag, method, remove_missing, num_threads);
+}
+
+}
@@ -0,0 +1,121 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "ranks.hpp"
+#include "parallel.hpp"
+
+namespace wdm {
+
+namespace impl {
+
+//! computes (weighted) ranks or pseudo-observations for all columns of a
+//! column-major matrix.
+//! @param x pointer to the input data.
+//! @param ld_x distance between the starts of two columns of `x`.
+//! @param n, d number of rows and columns.
+//! @param out pointer to the output.
+//! @param ld_out distance between the starts of two columns of `out`.
+//! @param weights pointer to the weights for each row; `nullptr` stands for
+//!   unit weights.
+//! @param ties_method see `rank()`.
+//! @param pseudo_obs whether ranks are divided by the number of non-missing
+//!   observations plus one.
+//! @param seeds seeds of the random number generator.
+//! @param num_threads number of threads; `0` uses all available cores.
+inline void rank_columns(const double* x,
+                         size_t ld_x,
+                         size_t n,
+                         size_t d,
+                         double* out,
+                         size_t ld_out,
+                         const double* weights,
+                         std::string ties_method,
+                         bool pseudo_obs,
+                         std::vector<int> seeds,
+                         size_t num_threads)
+{
+    check_ties_method(ties_method);
+    if ((ld_x < n) || (ld_out < n))
+        throw std::runtime_error("leading dimension must be at least n.");
+
+    uint64_t key = 0;
+    if (ties_method == "random")
+        key = random::make_key(seeds);
+
+    std::vector<Rank_workspace> ws(utils::num_threads(num_threads, d));
+    utils::parallel_for(d, num_threads, [&] (size_t j, size_t t) {
+        // every column gets its own random stream, so tie groups at the same
+        // positions are broken independently
+        uint64_t state = key + j;
+        uint64_t key_j = random::splitmix64(state);
+        double* out_j = out + j * ld_out;
+        size_t n_obs = rank_into(x + j * ld_x, n, weights, ties_method,
+                                 key_j, out_j, ws[t]);
+        if (pseudo_obs) {
+            for (size_t i = 0; i < n; i++)
+                out_j[i] /= static_cast<double>(n_obs + 1);
+        }
+    });
+}
+
+}
+
+//! computes (weighted) ranks for all columns of a matrix in parallel.
+//! @param x pointer to the input data (column-major, `n` rows and `d`
+//!    columns).
+//! @param n, d number of rows and columns.
+//! @param out pointer to the output (column-major, `n` rows and `d`
+//!    columns); may not alias `x`.
+//! @param weights pointer to the weights for each row; `nullptr` (default)
+//!    stands for unit weights.
+//! @param ties_method `"average"` (default), `"min"`, `"first"`, or
+//!    `"random"`; see details.
+//! @param seeds seeds of the random number generator; if empty (default),
+//!    the random number generator is seeded randomly.
+//! @param num_threads number of threads; `0` (default) uses all available
+//!    cores.
+//! @details
+//! Ranks are computed as in `impl::rank()`: weights are normalized to have
+//! mean one, so that the largest rank equals the number of non-missing values
+//! in a column. Missing values (`nan`) are passed through and ignored when
+//! ranking the other values. For `"random"`, the result is reproducible for
+//! given seeds and independent of the number of threads; every column uses
+//! its own random stream.
+inline void rank_matrix(const double* x,
+                        size_t n,
+                        size_t d,
+                        double* out,
+                        const double* weights = nullptr,
+                        std::string ties_method = "average",
+                        std::vector<int> seeds = std::vector<int>(),
+                        size_t num_threads = 0)
+{
+    impl::rank_columns(x, n, n, d, out, n, weights, ties_method, false,
+                       seeds, num_threads);
+}
+
+//! computes (weighted) pseudo-observations for all columns of a matrix in
+//! parallel.
+//!
+//! Pseudo-observations are the ranks divided by the number of non-missing
+//! values plus one and lie in \f$ (0, 1) \f$. Arguments are as in
+//! `rank_matrix()`.
+inline void pseudo_obs(const double* x,
+                       size_t n,
+                       size_t d,
+                       double* out,
+                       const double* weights = nullptr,
+                       std::string ties_method = "average",
+                       std::vector<int> seeds = std::vector<int>(),
+                       size_t num_threads = 0)
+{
+    impl::rank_columns(x, n, n, d, out, n, weights, ties_method, true,
+                       seeds, num_threads);
+}
+
+}
@@ -30,6 +30,20 @@ inline bool is_blomqvist(std::string method)
 {
     return (method == "blomqvist") || (method == "bbeta") || (method == "beta");
 }
+inline bool is_distance(std::string method)
+{
+    return (method == "distance") || (method == "dcor");
+}
+inline bool is_xi(std::string method)
+{
+    return (method == "xi") || (method == "chatterjee");
+}
+
+//! whether the dependence measure is symmetric in its two arguments.
+inline bool is_symmetric(std::string method)
+{
+    return !is_xi(method);
+}
 
 inline size_t get_min_nobs(std::string method)
 {
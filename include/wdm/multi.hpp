@@ -0,0 +1,222 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "utils.hpp"
+#include "ranks.hpp"
+#include "ktau.hpp"
+#include "hoeffd.hpp"
+#include "prho.hpp"
+#include "bbeta.hpp"
+#include "dcor.hpp"
+#include "xi.hpp"
+#include "methods.hpp"
+
+namespace wdm {
+
+namespace impl {
+
+//! number of weight vectors processed simultaneously in the Fenwick passes;
+//! bounds the memory of the trees to `lanes * n` doubles.
+const size_t multi_lanes = 8;
+
+//! collects a block of weight vectors into a row-major matrix in the order
+//! given by a permutation.
+//! @param weights the weight vectors.
+//! @param first, lanes index of the first weight vector and size of the
+//!   block.
+//! @param perm the permutation.
+//! @param power the power to which the weights are taken.
+inline std::vector<double> collect_lanes(
+    const std::vector<std::vector<double>>& weights,
+    size_t first,
+    size_t lanes,
+    const std::vector<size_t>& perm,
+    size_t power = 1)
+{
+    size_t n = perm.size();
+    std::vector<double> w(n * lanes);
+    for (size_t l = 0; l < lanes; l++) {
+        const auto& wl = weights[first + l];
+        for (size_t k = 0; k < n; k++) {
+            double wk = 1.0;
+            for (size_t p = 0; p < power; p++)
+                wk *= wl[perm[k]];
+            w[k * lanes + l] = wk;
+        }
+    }
+
+    return w;
+}
+
+//! counts the (weighted) number of discordant pairs for several weight
+//! vectors at once.
+//! @param ranks_y dense ranks of `y` in x order (ties broken by `y`).
+//! @param w row-major matrix of weights in x order, one column per lane.
+//! @param lanes the number of lanes.
+//! @param max_rank the largest rank in `ranks_y`.
+inline std::vector<double> count_discordant_lanes(
+    const std::vector<size_t>& ranks_y,
+    const std::vector<double>& w,
+    size_t lanes,
+    size_t max_rank)
+{
+    utils::Fenwick_tree tree(max_rank, lanes);
+    std::vector<double> num_d(lanes, 0.0), total(lanes, 0.0), below(lanes);
+    for (size_t k = 0; k < ranks_y.size(); k++) {
+        const double* wk = &w[k * lanes];
+        tree.prefix_sum(ranks_y[k], below.data());
+        for (size_t l = 0; l < lanes; l++) {
+            num_d[l] += wk[l] * (total[l] - below[l]);
+            total[l] += wk[l];
+        }
+        tree.add(ranks_y[k], wk);
+    }
+
+    return num_d;
+}
+
+//! extracts a lane from a row-major matrix.
+inline std::vector<double> get_lane(const std::vector<double>& w,
+                                    size_t lanes,
+                                    size_t l)
+{
+    std::vector<double> wl(w.size() / lanes);
+    for (size_t k = 0; k < wl.size(); k++)
+        wl[k] = w[k * lanes + l];
+    return wl;
+}
+
+//! calculates a (weighted) dependence measure for several weight vectors,
+//! sorting and ranking the data only once.
+//! @param x, y input data (without missing values).
+//! @param method the dependence measure.
+//! @param weights the weight vectors (without missing values); an empty
+//!   vector stands for unit weights.
+//! @return a vector containing the dependence measure for each weight vector.
+inline std::vector<double> wdm_multi(const std::vector<double>& x,
+                                     const std::vector<double>& y,
+                                     std::string method,
+                                     std::vector<std::vector<double>> weights)
+{
+    WDM_PROFILE_SCOPE("wdm_multi", x.size() * weights.size());
+    size_t n = x.size(), m = weights.size();
+    for (auto& w : weights) {
+        if (w.size() == 0)
+            w = std::vector<double>(n, 1.0);
+        utils::check_sizes(x, y, w);
+    }
+    std::vector<double> res(m);
+    if (m == 0)
+        return res;
+
+    if (methods::is_pearson(method)) {
+        for (size_t l = 0; l < m; l++)
+            res[l] = prho(x, y, weights[l]);
+        return res;
+    }
+    if (methods::is_distance(method)) {
+        // the marginal quantities depend on the weights; only the orderings
+        // are shared
+        auto order_x = utils::get_order(x);
+        auto order_y = utils::get_order(y);
+        for (size_t l = 0; l < m; l++) {
+            res[l] = dcor_from_margins(dcor_margin(x, weights[l], order_x),
+                                       dcor_margin(y, weights[l], order_y),
+                                       weights[l]);
+        }
+        return res;
+    }
+    if (methods::is_xi(method)) {
+        auto order_x = xi_order(x, random::make_key(xi_default_seeds()));
+        for (size_t l = 0; l < m; l++)
+            res[l] = xi_from_order(order_x, xi_response(y, weights[l]), weights[l]);
+        return res;
+    }
+
+    // one sort per variable (breaking ties by the other one)
+    std::vector<size_t> order_x = utils::get_joint_order(x, y);
+    std::vector<size_t> order_y = utils::get_joint_order(y, x);
+    auto xs = utils::permute(x, order_x);
+    auto ys = utils::permute(y, order_y);
+
+    if (methods::is_spearman(method)) {
+        for (size_t l = 0; l < m; l++) {
+            res[l] = prho(rank0_from_order(x, order_x, weights[l], "average"),
+                          rank0_from_order(y, order_y, weights[l], "average"),
+                          weights[l]);
+        }
+    } else if (methods::is_blomqvist(method)) {
+        for (size_t l = 0; l < m; l++) {
+            double med_x = median_sorted(xs, utils::permute(weights[l], order_x));
+            double med_y = median_sorted(ys, utils::permute(weights[l], order_y));
+            res[l] = bbeta_from_medians(x, y, weights[l], med_x, med_y);
+        }
+    } else if (methods::is_kendall(method)) {
+        auto ranks_y = utils::dense_ranks(y, order_y);
+        size_t max_rank = (n > 0) ? ranks_y[order_y[n - 1]] : 0;
+        auto ranks_ys = std::vector<size_t>(n);
+        for (size_t k = 0; k < n; k++)
+            ranks_ys[k] = ranks_y[order_x[k]];
+        auto y_by_x = utils::permute(y, order_x);
+        for (size_t first = 0; first < m; first += multi_lanes) {
+            size_t lanes = std::min(multi_lanes, m - first);
+            auto w = collect_lanes(weights, first, lanes, order_x);
+            std::vector<double> num_d;
+            {
+                WDM_PROFILE_SCOPE("merge_sort", n * lanes);
+                num_d = count_discordant_lanes(ranks_ys, w, lanes, max_rank);
+            }
+            for (size_t l = 0; l < lanes; l++) {
+                auto wx = get_lane(w, lanes, l);
+                auto wy = utils::permute(weights[first + l], order_y);
+                double ties_x = utils::count_tied_pairs(xs, wx);
+                double ties_both = utils::count_joint_ties(xs, y_by_x, wx);
+                double ties_y = utils::count_tied_pairs(ys, wy);
+                double num_pairs = utils::perm_sum(wx, 2);
+                res[first + l] = ktau_from_counts(
+                    num_pairs, num_d[l], ties_x, ties_y, ties_both);
+            }
+        }
+    } else if (methods::is_hoeffding(method)) {
+        auto ranks_y = utils::dense_ranks(y, order_y);
+        size_t max_rank = (n > 0) ? ranks_y[order_y[n - 1]] : 0;
+        for (size_t first = 0; first < m; first += multi_lanes) {
+            size_t lanes = std::min(multi_lanes, m - first);
+            // bivariate ranks for all lanes and powers 1 to 4 of the weights
+            std::vector<std::vector<double>> bivariate(4);
+            for (size_t p = 0; p < 4; p++) {
+                auto w = collect_lanes(weights, first, lanes, order_x, p + 1);
+                bivariate[p] =
+                    bivariate_rank_lanes(x, order_x, ranks_y, w, lanes, max_rank);
+            }
+            for (size_t l = 0; l < lanes; l++) {
+                const auto& wl = weights[first + l];
+                auto w2 = utils::pow(wl, 2);
+                res[first + l] = hoeffd_from_ranks(
+                    mid_rank0_from_order(x, order_x, wl),
+                    mid_rank0_from_order(y, order_y, wl),
+                    mid_rank0_from_order(x, order_x, w2),
+                    mid_rank0_from_order(y, order_y, w2),
+                    get_lane(bivariate[0], lanes, l),
+                    get_lane(bivariate[1], lanes, l),
+                    get_lane(bivariate[2], lanes, l),
+                    get_lane(bivariate[3], lanes, l),
+                    wl,
+                    utils::power_sums(wl, 5));
+            }
+        }
+    } else {
+        throw std::runtime_error("method not implemented.");
+    }
+
+    return res;
+}
+
+}
+
+}
@@ -8,6 +8,7 @@
 
 #include <limits>
 #include <sstream>
+#include "profiling.hpp"
 
 namespace wdm {
 
@@ -50,20 +51,24 @@ inline std::string preproc(std::vector<double>& x,
                            std::vector<double>& y,
                            std::vector<double>& weights,
                            std::string method,
-                           bool remove_missing)
+                           bool remove_missing,
+                           bool no_missing = false)
 {
+    WDM_PROFILE_SCOPE("preproc", x.size());
     size_t min_nobs = (method == "hoeffding") ? 5 : 2;
     if (remove_missing) {
-        utils::remove_incomplete(x, y, weights);
+        if (!no_missing)
+            utils::remove_incomplete(x, y, weights);
         if (x.size() < min_nobs)
             return "return_nan";
     } else {
         std::stringstream msg;
-        if (utils::any_nan(x) || utils::any_nan(y) || utils::any_nan(weights)) {
+        if (!no_missing &&
+            (utils::any_nan(x) || utils::any_nan(y) || utils::any_nan(weights))) {
             msg << "there are missing values in the data; " <<
                    "try remove_missing = TRUE";
         } else if (x.size() < min_nobs) {
-            msg << "need at least " << min_nobs << "observations.";
+            msg << "need at least " << min_nobs << " observations.";
         }
         if (!msg.str().empty())
             throw std::runtime_error(msg.str());
@@ -0,0 +1,81 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace wdm {
+
+namespace utils {
+
+//! resolves the number of threads to use.
+//! @param num_threads requested number of threads; `0` stands for the number
+//!   of concurrent threads supported by the hardware.
+//! @param n number of work items.
+inline size_t num_threads(size_t num_threads, size_t n)
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    return std::max(static_cast<size_t>(1), std::min(num_threads, n));
+}
+
+//! calls `f(k, t)` for `k = 0, ..., n - 1` using several threads.
+//!
+//! Work items are handed out dynamically; `t` is the index of the thread
+//! processing item `k` (less than `num_threads(num_threads, n)`) and can be
+//! used to address per-thread buffers. The calling thread takes part in the
+//! work. If `f` throws, the remaining items are skipped and the first
+//! exception is rethrown in the calling thread.
+//!
+//! @param n number of work items.
+//! @param num_threads number of threads; `0` uses all available cores.
+//! @param f the function to call.
+template<class F>
+inline void parallel_for(size_t n, size_t num_threads, F f)
+{
+    num_threads = utils::num_threads(num_threads, n);
+    if (num_threads == 1) {
+        for (size_t k = 0; k < n; k++)
+            f(k, 0);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex mtx;
+    auto work = [&] (size_t t) {
+        for (size_t k = next++; k < n; k = next++) {
+            try {
+                f(k, t);
+            } catch (...) {
+                std::lock_guard<std::mutex> lk(mtx);
+                if (!error)
+                    error = std::current_exception();
+                next = n;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; t++)
+        threads.emplace_back(work, t);
+    work(0);
+    for (auto& thread : threads)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+}
+
+}
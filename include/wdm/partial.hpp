@@ -0,0 +1,120 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "eigen.hpp"
+
+namespace wdm {
+
+namespace impl {
+
+//! maps a matrix of dependence measures to the corresponding Pearson
+//! correlations under a Gaussian copula.
+//! @param m a matrix of dependence measures.
+//! @param method the dependence measure.
+inline Eigen::MatrixXd to_pearson_scale(const Eigen::MatrixXd& m,
+                                        std::string method)
+{
+    const double pi = std::acos(-1);
+    if (methods::is_pearson(method))
+        return m;
+    if (methods::is_kendall(method) || methods::is_blomqvist(method))
+        return (m * pi / 2).array().sin();
+    if (methods::is_spearman(method))
+        return (m * pi / 6).array().sin() * 2;
+    throw std::runtime_error("partial correlations are only available for "
+                             "pearson, spearman, kendall, and blomqvist.");
+}
+
+}
+
+//! calculates partial correlations of all pairs of variables given all
+//! other variables.
+//!
+//! The matrix of dependence measures is computed once and mapped to the
+//! Pearson scale using the relations that hold under a Gaussian copula:
+//! \f$ \sin(\pi \tau / 2) \f$ for Kendall's \f$ \tau \f$ and Blomqvist's
+//! \f$ \beta \f$, \f$ 2 \sin(\pi \rho / 6) \f$ for Spearman's \f$ \rho \f$.
+//! The result is shrunk towards the identity,
+//! \f$ R_\lambda = (1 - \lambda) R + \lambda I \f$, and all partial
+//! correlations are obtained from a single factorization of \f$ R_\lambda \f$
+//! as \f$ -P_{ij} / \sqrt{P_{ii} P_{jj}} \f$, where
+//! \f$ P = R_\lambda^{-1} \f$ is the precision matrix.
+//!
+//! @param x input data.
+//! @param method the dependence measure; one of `"pearson"`, `"spearman"`,
+//!    `"kendall"`, `"blomqvist"` (or their aliases, see `wdm()`).
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed (separately for each pair); otherwise throws an error if `nan`s
+//!    are present.
+//! @param shrinkage the shrinkage intensity \f$ \lambda \in [0, 1] \f$;
+//!    positive values stabilize matrices that are (close to) singular.
+//! @details
+//! A Cholesky factorization is used if \f$ R_\lambda \f$ is positive
+//! definite. Singular, positive semi-definite matrices (for collinear
+//! variables or more variables than observations) are inverted by the
+//! Moore-Penrose pseudo-inverse, computed from an eigendecomposition in which
+//! eigenvalues below \f$ d \epsilon \lambda_{\max} \f$ are treated as
+//! zero. Matrices with negative eigenvalues (which may occur after the
+//! transformation or for pairwise removal of missing values) throw an error;
+//! increasing `shrinkage` helps in this case.
+//!
+//! @return the matrix of partial correlations with a unit diagonal.
+inline Eigen::MatrixXd partial_cor(const Eigen::MatrixXd& x,
+                                   std::string method = "pearson",
+                                   Eigen::VectorXd weights = Eigen::VectorXd(),
+                                   bool remove_missing = true,
+                                   double shrinkage = 0.0)
+{
+    WDM_PROFILE_SCOPE("partial", x.size());
+    if (!(shrinkage >= 0.0) || (shrinkage > 1.0))
+        throw std::runtime_error("shrinkage must be in [0, 1].");
+    // validates the method before the matrix is computed
+    impl::to_pearson_scale(Eigen::MatrixXd(), method);
+
+    size_t d = x.cols();
+    Eigen::MatrixXd r = impl::to_pearson_scale(
+        wdm(x, method, weights, remove_missing), method);
+    if (r.hasNaN())
+        throw std::runtime_error("the dependence matrix contains missing values.");
+    r *= 1 - shrinkage;
+    r.diagonal().setOnes();
+
+    Eigen::MatrixXd id = Eigen::MatrixXd::Identity(d, d);
+    Eigen::MatrixXd prec;
+    Eigen::LLT<Eigen::MatrixXd> llt(r);
+    if (llt.info() == Eigen::Success) {
+        prec = llt.solve(id);
+    } else {
+        Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eig(r);
+        if (eig.info() != Eigen::Success)
+            throw std::runtime_error("the eigendecomposition of the "
+                                     "dependence matrix failed.");
+        const Eigen::VectorXd& lambda = eig.eigenvalues();
+        double tol = d * std::numeric_limits<double>::epsilon() *
+            lambda.cwiseAbs().maxCoeff();
+        if (lambda.minCoeff() < -tol)
+            throw std::runtime_error("the dependence matrix is not positive "
+                                     "semi-definite; try a larger shrinkage.");
+        Eigen::VectorXd inv = Eigen::VectorXd::Zero(d);
+        for (size_t k = 0; k < d; k++) {
+            if (lambda(k) > tol)
+                inv(k) = 1.0 / lambda(k);
+        }
+        prec = eig.eigenvectors() * inv.asDiagonal() *
+            eig.eigenvectors().transpose();
+    }
+
+    Eigen::VectorXd s = prec.diagonal().cwiseSqrt().cwiseInverse();
+    Eigen::MatrixXd pc = -(s.asDiagonal() * prec * s.asDiagonal());
+    pc.diagonal().setOnes();
+
+    return pc;
+}
+
+}
@@ -13,46 +13,67 @@ namespace wdm {
 
 namespace impl {
     
-//! fast calculation of the weighted Pearson's correlation.
-//! @param x, y input data.
-//! @param weights an optional vector of weights for the data.
-inline double prho(std::vector<double> x,
-                   std::vector<double> y,
-                   std::vector<double> weights = std::vector<double>())
+//! calculates the weighted Pearson's correlation from raw arrays.
+//! @tparam W the weight policy (see `utils::Weighted`).
+//! @param x, y pointers to the input data.
+//! @param weights pointer to the weights; only read if `W` is
+//!   `utils::Weighted`.
+//! @param n the number of observations.
+template<class W>
+double prho_raw(const double* x, const double* y, const double* weights, size_t n)
 {
-    utils::check_sizes(x, y, weights);
-    size_t n = x.size();
-    if (weights.size() == 0)
-        weights = std::vector<double>(x.size(), 1.0);
-
     // calculate means of x and y
     double mu_x = 0.0, mu_y = 0.0, w_sum = 0.0;
     for (size_t i = 0; i < n; i++) {
-        mu_x += x[i] * weights[i];
-        mu_y += y[i] * weights[i];
-        w_sum += weights[i];
+        double w = W::get(weights, i);
+        mu_x += x[i] * w;
+        mu_y += y[i] * w;
+        w_sum += w;
     }
     mu_x /= w_sum;
     mu_y /= w_sum;
 
-    // substract mean from x and y
-    for (size_t i = 0; i < n; i++) {
-        x[i] -= mu_x;
-        y[i] -= mu_y;
-    }
-
-    // compute variances and covariance
+    // compute variances and covariance of the centered data
     double v_x = 0.0, v_y = 0.0, cov = 0.0;
     for (size_t i = 0; i < n; i++) {
-        v_x += x[i] * x[i] * weights[i];
-        v_y += y[i] * y[i] * weights[i];
-        cov += x[i] * y[i] * weights[i];
+        double w = W::get(weights, i);
+        double xc = x[i] - mu_x, yc = y[i] - mu_y;
+        v_x += xc * xc * w;
+        v_y += yc * yc * w;
+        cov += xc * yc * w;
     }
 
     // compute correlation
     return cov / std::sqrt(v_x * v_y);
 }
 
+//! calculates the weighted Pearson's correlation from raw arrays.
+//! @param x, y pointers to the input data.
+//! @param weights pointer to the weights; `nullptr` stands for unit weights.
+//! @param n the number of observations.
+inline double prho_raw(const double* x,
+                       const double* y,
+                       const double* weights,
+                       size_t n)
+{
+    if (weights)
+        return prho_raw<utils::Weighted>(x, y, weights, n);
+    return prho_raw<utils::Unweighted>(x, y, nullptr, n);
+}
+
+//! fast calculation of the weighted Pearson's correlation.
+//! @param x, y input data.
+//! @param weights an optional vector of weights for the data.
+inline double prho(const std::vector<double>& x,
+                   const std::vector<double>& y,
+                   const std::vector<double>& weights = std::vector<double>())
+{
+    WDM_PROFILE_SCOPE("prho", x.size());
+    utils::check_sizes(x, y, weights);
+    return prho_raw(x.data(), y.data(),
+                    weights.size() > 0 ? weights.data() : nullptr, x.size());
+}
+
 }
 
 }
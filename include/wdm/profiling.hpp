@@ -0,0 +1,154 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Instrumentation of the computations is only compiled if WDM_PROFILING is
+// defined; otherwise the macros below expand to nothing and the functions in
+// wdm::profiling report empty statistics.
+#ifdef WDM_PROFILING
+#define WDM_PROFILE_CONCAT_(a, b) a##b
+#define WDM_PROFILE_CONCAT(a, b) WDM_PROFILE_CONCAT_(a, b)
+#define WDM_PROFILE_SCOPE(phase, elements)                                     \
+    ::wdm::profiling::Scope WDM_PROFILE_CONCAT(wdm_profile_scope_, __LINE__)(  \
+        phase, elements)
+#define WDM_PROFILE_ALLOC(bytes) ::wdm::profiling::add_bytes(bytes)
+#else
+#define WDM_PROFILE_SCOPE(phase, elements)
+#define WDM_PROFILE_ALLOC(bytes)
+#endif
+
+namespace wdm {
+
+//! Instrumentation of the computations (enabled by defining `WDM_PROFILING`).
+//!
+//! Phases currently recorded: `"preproc"` (NaN handling), `"sort"`,
+//! `"ties"` (tie counting), `"merge_sort"` (inversion counting), `"ranks"`,
+//! `"bivariate_ranks"`, the estimators (`"prho"`, `"srho"`, `"ktau"`,
+//! `"bbeta"`, `"hoeffd"`, `"wdm_all"`), and `"matrix"` for the Eigen matrix
+//! interface. Phases can be nested; times are inclusive.
+namespace profiling {
+
+//! statistics recorded for a phase of the computations.
+struct Phase_stats {
+    std::string phase;    //!< name of the phase.
+    size_t calls;         //!< number of times the phase was entered.
+    double seconds;       //!< total wall time spent in the phase.
+    size_t bytes;         //!< bytes allocated for temporaries in the phase
+                          //!< (excluding nested phases).
+    size_t elements;      //!< number of elements processed in the phase.
+};
+
+//! a function that is called whenever a phase is left; it receives the
+//! statistics of that single call.
+typedef std::function<void(const Phase_stats&)> Callback;
+
+inline std::vector<Phase_stats>& thread_stats()
+{
+    static thread_local std::vector<Phase_stats> stats;
+    return stats;
+}
+
+inline Callback& callback()
+{
+    static Callback cb;
+    return cb;
+}
+
+//! returns the statistics collected by the calling thread since the last
+//! call to `reset()`; empty unless `WDM_PROFILING` is defined.
+inline std::vector<Phase_stats> stats()
+{
+    return thread_stats();
+}
+
+//! resets the statistics collected by the calling thread.
+inline void reset()
+{
+    thread_stats().clear();
+}
+
+//! sets a callback that is invoked whenever a phase is left (in any thread);
+//! it should be set before starting any computations. An empty function
+//! removes the callback.
+inline void set_callback(Callback cb)
+{
+    callback() = cb;
+}
+
+//! records the time, allocations, and elements of a phase for the lifetime of
+//! the object.
+class Scope {
+public:
+    Scope(const char* phase, size_t elements) :
+        phase_(phase),
+        elements_(elements),
+        bytes_(0),
+        parent_(current()),
+        start_(std::chrono::steady_clock::now())
+    {
+        current() = this;
+    }
+
+    ~Scope()
+    {
+        std::chrono::duration<double> dt =
+            std::chrono::steady_clock::now() - start_;
+        current() = parent_;
+
+        Phase_stats call{phase_, 1, dt.count(), bytes_, elements_};
+        auto& stats = thread_stats();
+        size_t k = 0;
+        while ((k < stats.size()) && (stats[k].phase != call.phase))
+            k++;
+        if (k == stats.size()) {
+            stats.push_back(call);
+        } else {
+            stats[k].calls++;
+            stats[k].seconds += call.seconds;
+            stats[k].bytes += call.bytes;
+            stats[k].elements += call.elements;
+        }
+        if (callback())
+            callback()(call);
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    //! the innermost phase of the calling thread.
+    static Scope*& current()
+    {
+        static thread_local Scope* scope = nullptr;
+        return scope;
+    }
+
+    //! attributes allocated bytes to this phase.
+    void add_bytes(size_t bytes) { bytes_ += bytes; }
+
+private:
+    const char* phase_;
+    size_t elements_;
+    size_t bytes_;
+    Scope* parent_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+//! attributes allocated bytes to the innermost phase of the calling thread.
+inline void add_bytes(size_t bytes)
+{
+    if (Scope::current())
+        Scope::current()->add_bytes(bytes);
+}
+
+}
+
+}
@@ -9,6 +9,8 @@
 #endif
 
 #include <algorithm> // For std::generate
+#include <cstdint>
+#include <limits>
 #include <random>    // For std::random_device
 
 namespace wdm
@@ -17,6 +19,10 @@ namespace wdm
   namespace random
   {
 
+    // Random number generator based on the standard library (or Boost if
+    // USE_BOOST is defined). The library itself uses Xoshiro256 below, whose
+    // streams do not depend on the standard library or on the partitioning
+    // of work across threads; this class is only kept for API compatibility.
     class RandomGenerator
     {
     public:
@@ -92,9 +98,147 @@ namespace wdm
       }
     };
 
-    // Custom shuffle function
-    template <typename T>
-    void shuffle(std::vector<T> &vec, RandomGenerator &rand_gen)
+    // SplitMix64 step; used to derive seeds and streams
+    inline uint64_t splitmix64(uint64_t &state)
+    {
+      uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31);
+    }
+
+    // Combines seeds into a single 64-bit key; draws a random key from
+    // std::random_device if no seeds are given
+    inline uint64_t make_key(const std::vector<int> &seeds)
+    {
+      uint64_t key = 0;
+      if (seeds.empty())
+      {
+        std::random_device rd{};
+        key = (static_cast<uint64_t>(rd()) << 32) ^ rd();
+      }
+      for (int seed : seeds)
+      {
+        key ^= static_cast<uint32_t>(seed);
+        splitmix64(key);
+      }
+      return key;
+    }
+
+    // xoshiro256** generator (Blackman and Vigna) with counter-based streams.
+    //
+    // The generator for stream k is derived from a key and the stream index
+    // alone, so that random numbers can be assigned to units of work (e.g.,
+    // tie groups) reproducibly, independent of how the work is partitioned
+    // across threads. jump() advances the state by 2^128 steps and can be
+    // used to obtain non-overlapping subsequences.
+    class Xoshiro256
+    {
+    public:
+      typedef uint64_t result_type;
+
+      // Constructor from a key (see make_key()) and a stream index
+      explicit Xoshiro256(uint64_t key, uint64_t stream = 0)
+      {
+        uint64_t sm = key ^ (stream * 0xd1342543de82ef95ULL);
+        splitmix64(sm);
+        for (int i = 0; i < 4; i++)
+          s[i] = splitmix64(sm);
+      }
+
+      static constexpr result_type min() { return 0; }
+      static constexpr result_type max()
+      {
+        return std::numeric_limits<result_type>::max();
+      }
+
+      result_type operator()()
+      {
+        const uint64_t result = rotl(s[1] * 5, 7) * 9;
+        const uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+      }
+
+      // Advance the state by 2^128 steps
+      void jump()
+      {
+        static const uint64_t JUMP[] = {
+            0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+            0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+        uint64_t t[4] = {0, 0, 0, 0};
+        for (int i = 0; i < 4; i++)
+        {
+          for (int b = 0; b < 64; b++)
+          {
+            if (JUMP[i] & (uint64_t{1} << b))
+            {
+              for (int k = 0; k < 4; k++)
+                t[k] ^= s[k];
+            }
+            (*this)();
+          }
+        }
+        for (int k = 0; k < 4; k++)
+          s[k] = t[k];
+      }
+
+      // Sample a size_t in [0, n-1] (Lemire's nearly divisionless method;
+      // the result does not depend on the standard library implementation)
+      size_t sample_int(size_t n)
+      {
+        uint64_t range = static_cast<uint64_t>(n);
+        uint64_t x = (*this)();
+        uint64_t m_hi, m_lo;
+        mul128(x, range, m_hi, m_lo);
+        if (m_lo < range)
+        {
+          uint64_t threshold = (0 - range) % range;
+          while (m_lo < threshold)
+          {
+            x = (*this)();
+            mul128(x, range, m_hi, m_lo);
+          }
+        }
+        return static_cast<size_t>(m_hi);
+      }
+
+      // Sample a double in [0.0, 1.0)
+      double sample_double()
+      {
+        return static_cast<double>((*this)() >> 11) * (1.0 / 9007199254740992.0);
+      }
+
+    private:
+      uint64_t s[4];
+
+      static uint64_t rotl(const uint64_t x, int k)
+      {
+        return (x << k) | (x >> (64 - k));
+      }
+
+      // Full 64 x 64 -> 128 bit product
+      static void mul128(uint64_t a, uint64_t b, uint64_t &hi, uint64_t &lo)
+      {
+        uint64_t a_lo = a & 0xffffffffULL, a_hi = a >> 32;
+        uint64_t b_lo = b & 0xffffffffULL, b_hi = b >> 32;
+        uint64_t p0 = a_lo * b_lo, p1 = a_lo * b_hi;
+        uint64_t p2 = a_hi * b_lo, p3 = a_hi * b_hi;
+        uint64_t mid = (p0 >> 32) + (p1 & 0xffffffffULL) + (p2 & 0xffffffffULL);
+        lo = (mid << 32) | (p0 & 0xffffffffULL);
+        hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+      }
+    };
+
+    // Fisher-Yates shuffle with a generator providing sample_int() (e.g.,
+    // Xoshiro256); used for random tie breaking in ranks
+    template <typename T, typename Generator>
+    void shuffle(std::vector<T> &vec, Generator &rand_gen)
     {
       for (size_t i = vec.size() - 1; i > 0; --i)
       {
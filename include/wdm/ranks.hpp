@@ -9,73 +9,96 @@
 #include "nan_handling.hpp"
 #include "utils.hpp"
 #include "random.hpp"
+#include "small.hpp"
 
 namespace wdm {
 
 namespace impl {
 
-  //! computes ranks.
-  //! @param x input vector.
-  //! @param weights (optional), weights for each observation.
-  //! @param ties_method `"min"` (default) assigns all tied values the minimum
-  //!   score; `"average"` assigns the average score, `"first"` ranks them in
-  //!   order of occurance, `"random"` randomizes.
-  //! @param seeds Seeds of the random number generator; if empty (default),
-  //!   the random number generator is seeded randomly.
-  //! @return a vector containing the ranks of each element in `x`.
-  inline std::vector<double>
-  rank(std::vector<double> x,
-       std::vector<double> weights = std::vector<double>(),
-       std::string ties_method = "min",
-       std::vector<int> seeds = std::vector<int>())
-  {
+//! reusable buffers for computing ranks of many vectors.
+struct Rank_workspace {
+    std::vector<double> x;
+    std::vector<double> weights;
+    std::vector<size_t> perm;
+    std::vector<size_t> rvals;
+};
+
+//! checks whether a ties method is supported by `rank()`.
+inline void check_ties_method(const std::string& ties_method)
+{
     if ((ties_method != "min") && (ties_method != "average") &&
         (ties_method != "first") && (ties_method != "random"))
         throw std::runtime_error(
           "ties method must be one of 'min', 'average', 'first', 'random'.");
+}
 
-    // set default weights if necessary
-    size_t n = x.size();
-    if (weights.size() == 0)
-        weights = std::vector<double>(n, 1.0);
-
-    if (weights.size() != n) {
-        throw std::runtime_error("weights and data must have same size.");
+//! computes ranks into a caller-provided buffer; see `rank()`.
+//! @param x pointer to the input data.
+//! @param n number of observations.
+//! @param weights pointer to the weights for each observation; `nullptr`
+//!   stands for unit weights.
+//! @param ties_method see `rank()`.
+//! @param key key of the random number generator (see `random::make_key()`);
+//!   only used if `ties_method` is `"random"`.
+//! @param ranks pointer to the output (`n` elements), may not alias `x`.
+//! @param ws buffers for intermediate results.
+//! @return the number of non-missing observations.
+inline size_t rank_into(const double* x,
+                        size_t n,
+                        const double* weights,
+                        const std::string& ties_method,
+                        uint64_t key,
+                        double* ranks,
+                        Rank_workspace& ws)
+{
+    WDM_PROFILE_SCOPE("ranks", n);
+    auto& xx = ws.x;
+    auto& ww = ws.weights;
+    xx.assign(x, x + n);
+    if (weights) {
+        ww.assign(weights, weights + n);
+    } else {
+        ww.assign(n, 1.0);
     }
 
     // NaN-handling
-    std::vector<double> nans;
-    if (utils::any_nan(x)) {
-        nans.resize(n, 0);
-        for (size_t i = 0; i < n; i++) {
-            if (std::isnan(x[i])) {
-                x[i] = std::numeric_limits<double>::max();
-                nans[i] = 1;
-                weights[i] = 0;
-            }
+    size_t n_nan = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (std::isnan(xx[i])) {
+            xx[i] = std::numeric_limits<double>::max();
+            ww[i] = 0;
+            n_nan++;
         }
     }
 
-    double w_mean =
-      utils::sum(weights) / static_cast<double>(n - utils::sum(nans));
-    for (auto& w : weights) {
+    double w_mean = utils::sum(ww) / static_cast<double>(n - n_nan);
+    for (auto& w : ww) {
         w = w / w_mean;
     }
 
     // permutation that brings 'x' in ascending order
-    std::vector<size_t> perm = utils::get_order(x);
+    auto& perm = ws.perm;
+    {
+        WDM_PROFILE_SCOPE("sort", n);
+        perm.resize(n);
+        std::iota(perm.begin(), perm.end(), 0);
+        std::sort(perm.begin(), perm.end(),
+                  [&] (size_t i, size_t j) { return xx[i] < xx[j]; });
+    }
 
+    // the random order of a tie group is drawn from a stream determined by
+    // the key and the group's position
     double w_acc = 0.0, w_batch;
     for (size_t i = 0, reps; i < n; i += reps) {
         // find replications
         reps = 0;
         w_batch = 0.0;
-        while ((i + reps < n) && (x[perm[i]] == x[perm[i + reps]]))
-            w_batch += weights[perm[i + reps++]];
+        while ((i + reps < n) && (xx[perm[i]] == xx[perm[i + reps]]))
+            w_batch += ww[perm[i + reps++]];
 
         // assign min rank
         for (size_t k = 0; k < reps; ++k)
-            x[perm[i + k]] = w_acc + weights[perm[i]];
+            ranks[perm[i + k]] = w_acc + ww[perm[i]];
 
         // accumulate weights for current batch
         w_acc += w_batch;
@@ -85,44 +108,150 @@ namespace impl {
 
         if (ties_method == "first") {
             // assign weighted ranks in order of appearance
-            double ww = 0;
+            double w_first = 0;
             for (size_t k = 1; k < reps; ++k) {
-                ww += weights[perm[i + k]];
-                x[perm[i + k]] += ww;
+                w_first += ww[perm[i + k]];
+                ranks[perm[i + k]] += w_first;
             }
         } else if (ties_method == "random") {
             // assign weighted ranks in random order
-            random::RandomGenerator random_gen(seeds);
-            std::vector<size_t> rvals(reps);
+            random::Xoshiro256 random_gen(key, i);
+            auto& rvals = ws.rvals;
+            rvals.resize(reps);
             std::iota(rvals.begin(), rvals.end(), 0); // 0, 1, 2, ...
             random::shuffle(rvals, random_gen);
 
-            double ww = 0;
-            for (size_t k = 1; k < reps; ++k) {
-                x[perm[i + rvals[k]]] += ww;
-                ww += weights[perm[i + rvals[k]]];
+            double w_rand = w_acc - w_batch;
+            for (size_t k = 0; k < reps; ++k) {
+                w_rand += ww[perm[i + rvals[k]]];
+                ranks[perm[i + rvals[k]]] = w_rand;
             }
         } else if (ties_method == "average") {
             // assign average rank to tied values
-            std::vector<double> ww(reps);
-            for (size_t k = 0; k < reps; ++k)
-                ww[k] = weights[perm[i + k]];
             for (size_t k = 0; k < reps; ++k)
-                x[perm[i + k]] += (utils::sum(ww) - weights[perm[i]]) / 2;
+                ranks[perm[i + k]] += (w_batch - ww[perm[i]]) / 2;
         }
     }
 
-    if (nans.size() == n) {
-        for (size_t i = 0; i < x.size(); i++) {
-            if (nans[i]) {
-                x[i] = NAN;
-            }
+    if (n_nan > 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (std::isnan(x[i]))
+                ranks[i] = NAN;
         }
     }
 
-    return x;
+    return n - n_nan;
+}
+
+  //! computes ranks.
+  //! @param x input vector.
+  //! @param weights (optional), weights for each observation.
+  //! @param ties_method `"min"` (default) assigns all tied values the minimum
+  //!   score; `"average"` assigns the average score, `"first"` ranks them in
+  //!   order of occurance, `"random"` randomizes.
+  //! @param seeds Seeds of the random number generator; if empty (default),
+  //!   the random number generator is seeded randomly. Given the seeds, the
+  //!   order within each tie group depends only on the data.
+  //! @return a vector containing the ranks of each element in `x`.
+  inline std::vector<double>
+  rank(std::vector<double> x,
+       std::vector<double> weights = std::vector<double>(),
+       std::string ties_method = "min",
+       std::vector<int> seeds = std::vector<int>())
+  {
+    check_ties_method(ties_method);
+
+    size_t n = x.size();
+    WDM_PROFILE_ALLOC(3 * n * sizeof(double));
+    if ((weights.size() > 0) && (weights.size() != n)) {
+        throw std::runtime_error("weights and data must have same size.");
+    }
+
+    uint64_t key = 0;
+    if (ties_method == "random")
+        key = random::make_key(seeds);
+
+    Rank_workspace ws;
+    std::vector<double> ranks(n);
+    rank_into(x.data(), n, weights.size() ? weights.data() : nullptr,
+              ties_method, key, ranks.data(), ws);
+
+    return ranks;
   }
 
+//! replaces data by their ranks (such that smallest element has rank 0),
+//! given a known ordering of the data.
+//! @tparam W the weight policy (see `utils::Weighted`).
+//! @param x input vector; overwritten by the ranks.
+//! @param perm a permutation that brings `x` in ascending order.
+//! @param weights pointer to the weights for each observation; only read if
+//!   `W` is `utils::Weighted`.
+//! @param average whether tied values get the average instead of the minimum
+//!   score.
+template<class W>
+void assign_rank0(std::vector<double>& x,
+                  const std::vector<size_t>& perm,
+                  const double* weights,
+                  bool average)
+{
+    size_t n = x.size();
+
+    // the average rank of a tie group adds the sum over all pairs within the
+    // group, (w_batch^2 - w2_batch) / 2, divided by the group's weight; it
+    // is computed from running sums so that each group takes linear time.
+    double w_acc = 0.0, w_batch, w2_batch;
+    for (size_t i = 0, reps; i < n; i += reps) {
+        // find replications
+        reps = 0;
+        w_batch = 0.0;
+        w2_batch = 0.0;
+        while ((i + reps < n) && (x[perm[i]] == x[perm[i + reps]])) {
+            double w = W::get(weights, perm[i + reps++]);
+            w_batch += w;
+            w2_batch += w * w;
+        }
+
+        // assign min or average rank
+        double r = w_acc;
+        if (average && (reps > 1))
+            r += (w_batch * w_batch - w2_batch) / 2 / w_batch;
+        for (size_t k = 0; k < reps; ++k)
+            x[perm[i + k]] = r;
+
+        // accumulate weights for current batch
+        w_acc += w_batch;
+    }
+}
+
+//! computes ranks (such that smallest element has rank 0) from a known
+//! ordering of the data.
+//! @param x input vector.
+//! @param perm a permutation that brings `x` in ascending order.
+//! @param weights (optional), weights for each observation.
+//! @param ties_method `"min"` (default) assigns all tied values the minimum
+//!   score; `"average"` assigns the average score.
+//! @return a vector containing the ranks of each element in `x`.
+inline std::vector<double> rank0_from_order(
+    std::vector<double> x,
+    const std::vector<size_t>& perm,
+    const std::vector<double>& weights = std::vector<double>(),
+    std::string ties_method = "min")
+{
+    if ((ties_method != "min") && (ties_method != "average"))
+        throw std::runtime_error("ties_method must be either 'min' or 'average.");
+
+    WDM_PROFILE_SCOPE("ranks", x.size());
+    WDM_PROFILE_ALLOC(x.size() * sizeof(double));
+    bool average = (ties_method == "average");
+    if (weights.size() > 0) {
+        assign_rank0<utils::Weighted>(x, perm, weights.data(), average);
+    } else {
+        assign_rank0<utils::Unweighted>(x, perm, nullptr, average);
+    }
+
+    return x;
+}
+
 //! computes ranks (such that smallest element has rank 0), assigning average
 //! ranks for ties.
 //! @param x input vector.
@@ -135,104 +264,186 @@ inline std::vector<double> rank0(
     std::vector<double> weights = std::vector<double>(),
     std::string ties_method = "min")
 {
-    if ((ties_method != "min") && (ties_method != "average"))
-        throw std::runtime_error("ties_method must be either 'min' or 'average.");
-
-    // set default weights if necessary
-    size_t n = x.size();
-    if (weights.size() == 0)
-        weights = std::vector<double>(n, 1.0);
+    if ((x.size() <= small_n_max) && (weights.size() <= x.size())) {
+        if ((ties_method != "min") && (ties_method != "average"))
+            throw std::runtime_error(
+                "ties_method must be either 'min' or 'average.");
+        std::vector<double> ranks(x.size());
+        rank0_small(x.data(), weights.size() > 0 ? weights.data() : nullptr,
+                    x.size(), ties_method == "average", ranks.data());
+        return ranks;
+    }
 
     // permutation that brings 'x' in ascending order
     std::vector<size_t> perm = utils::get_order(x);
+    return rank0_from_order(x, perm, weights, ties_method);
+}
 
-    double w_acc = 0.0, w_batch;
-    for (size_t i = 0, reps; i < n; i += reps) {
-        // find replications
-        reps = 0;
-        w_batch = 0.0;
-        while ((i + reps < n) && (x[perm[i]] == x[perm[i + reps]]))
-            w_batch += weights[perm[i + reps++]];
-
-        // assign min rank
-        for (size_t k = 0; k < reps; ++k)
-            x[perm[i + k]] = w_acc;
-
-        // accumulate weights for current batch
+//! computes the (weighted) number of observations below each element,
+//! counting the other observations tied with it by half; these are the
+//! marginal ranks of Hoeffding's \f$ D \f$.
+//! @param x input vector.
+//! @param perm a permutation that brings `x` in ascending order.
+//! @param weights (optional), weights for each observation.
+inline std::vector<double> mid_rank0_from_order(
+    const std::vector<double>& x,
+    const std::vector<size_t>& perm,
+    const std::vector<double>& weights = std::vector<double>())
+{
+    WDM_PROFILE_SCOPE("ranks", x.size());
+    auto weight = [&weights] (size_t i) {
+        return (weights.size() > 0) ? weights[i] : 1.0;
+    };
+    std::vector<double> ranks(x.size());
+    double w_acc = 0.0;
+    for (size_t i = 0, reps; i < x.size(); i += reps) {
+        double w_batch = 0.0;
+        for (reps = 0; (i + reps < x.size()) &&
+                 (x[perm[i + reps]] == x[perm[i]]); reps++)
+            w_batch += weight(perm[i + reps]);
+        for (size_t k = i; k < i + reps; k++)
+            ranks[perm[k]] = w_acc + 0.5 * (w_batch - weight(perm[k]));
         w_acc += w_batch;
+    }
 
-        // assign average rank to tied values
-        if ((ties_method == "average") && (reps > 1)) {
-            std::vector<double> ww(reps);
-            for (size_t k = 0; k < reps; ++k)
-                ww[k] = weights[perm[i + k]];
-            for (size_t k = 0; k < reps; ++k)
-                x[perm[i + k]] += utils::perm_sum(ww, 2) / w_batch;
+    return ranks;
+}
+
+//! computes (weighted) bivariate ranks for several weight vectors at once.
+//!
+//! The bivariate rank of an observation is the (weighted) number of other
+//! observations below it in both variables. As in Hoeffding's original
+//! definition, observations tied with it in one variable and below it in
+//! the other count by one half, and observations tied in both by one
+//! quarter.
+//!
+//! @tparam W the weight policy (see `utils::Weighted`); for
+//!   `utils::Unweighted`, `w` is not read and there must be a single lane.
+//! @param x the first variable (in original order).
+//! @param order_x permutation that brings the data in x order, breaking
+//!   ties by y.
+//! @param ranks_y dense ranks of `y` (in original order).
+//! @param w row-major matrix of weights in x order, one column per lane.
+//! @param lanes the number of lanes.
+//! @param max_rank the largest rank in `ranks_y`.
+//! @return a row-major matrix of bivariate ranks in original order.
+template<class W>
+std::vector<double> bivariate_rank_lanes(const std::vector<double>& x,
+                                         const std::vector<size_t>& order_x,
+                                         const std::vector<size_t>& ranks_y,
+                                         const std::vector<double>& w,
+                                         size_t lanes,
+                                         size_t max_rank)
+{
+    WDM_PROFILE_SCOPE("bivariate_ranks", order_x.size());
+    size_t n = order_x.size();
+    const std::vector<double> ones(lanes, 1.0);
+    auto weight = [&] (size_t k) {
+        return W::weighted ? &w[k * lanes] : ones.data();
+    };
+
+    // the tree holds the observations with smaller x; within a group of
+    // tied x, the observations are visited in y order
+    utils::Fenwick_tree tree(max_rank, lanes);
+    std::vector<double> counts(n * lanes);
+    std::vector<double> below(lanes), at(lanes), group(lanes), tied(lanes);
+    for (size_t g = 0, g_end; g < n; g = g_end) {
+        for (g_end = g + 1;
+             (g_end < n) && (x[order_x[g_end]] == x[order_x[g]]); g_end++) {}
+        std::fill(group.begin(), group.end(), 0.0);
+        for (size_t k = g, k_end; k < g_end; k = k_end) {
+            size_t r = ranks_y[order_x[k]];
+            std::fill(tied.begin(), tied.end(), 0.0);
+            for (k_end = k;
+                 (k_end < g_end) && (ranks_y[order_x[k_end]] == r); k_end++) {
+                for (size_t l = 0; l < lanes; l++)
+                    tied[l] += weight(k_end)[l];
+            }
+            tree.prefix_sum(r - 1, below.data());
+            tree.prefix_sum(r, at.data());
+            for (size_t kk = k; kk < k_end; kk++) {
+                double* c = &counts[order_x[kk] * lanes];
+                const double* wk = weight(kk);
+                for (size_t l = 0; l < lanes; l++) {
+                    c[l] = below[l] + 0.5 * (at[l] - below[l] + group[l]) +
+                        0.25 * (tied[l] - wk[l]);
+                }
+            }
+            for (size_t l = 0; l < lanes; l++)
+                group[l] += tied[l];
         }
+        for (size_t k = g; k < g_end; k++)
+            tree.add(ranks_y[order_x[k]], weight(k));
     }
 
-    return x;
+    return counts;
+}
+
+//! computes (weighted) bivariate ranks for several weight vectors at once;
+//! see above.
+//! @param x the first variable (in original order).
+//! @param order_x permutation that brings the data in x order, breaking
+//!   ties by y.
+//! @param ranks_y dense ranks of `y` (in original order).
+//! @param w row-major matrix of weights in x order, one column per lane.
+//! @param lanes the number of lanes.
+//! @param max_rank the largest rank in `ranks_y`.
+inline std::vector<double> bivariate_rank_lanes(
+    const std::vector<double>& x,
+    const std::vector<size_t>& order_x,
+    const std::vector<size_t>& ranks_y,
+    const std::vector<double>& w,
+    size_t lanes,
+    size_t max_rank)
+{
+    return bivariate_rank_lanes<utils::Weighted>(x, order_x, ranks_y, w, lanes,
+                                                 max_rank);
 }
 
 //! computes the bivariate rank of a pair of vectors (starting at 0).
 //! @param x first input vector.
 //! @param y second input vecotr.
 //! @param weights (optional), weights for each observation.
+//! @details The bivariate rank of an observation is the (weighted) number of
+//!   other observations below it in both variables, where ties in one
+//!   variable count by one half and ties in both by one quarter.
 inline std::vector<double>
-bivariate_rank(std::vector<double> x,
-               std::vector<double> y,
+bivariate_rank(const std::vector<double>& x,
+               const std::vector<double>& y,
                std::vector<double> weights = std::vector<double>())
 {
     utils::check_sizes(x, y, weights);
 
-    // get inverse of permutation that brings x in ascending order
-    std::vector<size_t> perm_x = utils::get_order(x);
-    perm_x = utils::invert_permutation(perm_x);
-
-    // sort x, y, and weights according to x, breaking ties with y
-    utils::sort_all(x, y, weights);
-
-    // get inverse of permutation that brings y in descending order
-    std::vector<size_t> perm_y = utils::get_order(y, false);
-    perm_y = utils::invert_permutation(perm_y);
+    // sort according to x, breaking ties with y; dense ranks of y
+    std::vector<size_t> order_x = utils::get_joint_order(x, y);
+    std::vector<size_t> order_y = utils::get_order(y);
+    std::vector<size_t> ranks_y = utils::dense_ranks(y, order_y);
+    size_t max_rank = (y.size() > 0) ? ranks_y[order_y.back()] : 0;
 
-    // sort y in descending order counting inversions
-    std::vector<double> counts(y.size(), 0.0);
-    utils::merge_sort_count_per_element(y, weights, counts);
-
-    // bring counts back in original order
-    std::vector<double> counts_tmp = counts;
-    for (size_t i = 0; i < counts.size(); i++)
-        counts[i] = counts_tmp[perm_y[perm_x[i]]];
-
-    return counts;
+    if (weights.size() == 0) {
+        return bivariate_rank_lanes<utils::Unweighted>(
+            x, order_x, ranks_y, weights, 1, max_rank);
+    }
+    return bivariate_rank_lanes<utils::Weighted>(
+        x, order_x, ranks_y, utils::permute(weights, order_x), 1, max_rank);
 }
 
-//! computes the (weighted) median of a vector.
-//! @param x the input vector.
+//! computes the (weighted) median of a sorted vector.
+//! @param xx the input vector, sorted in ascending order.
+//! @param w (optional), weights for each observation.
 inline double
-median(const std::vector<double>& x,
-       std::vector<double> weights = std::vector<double>())
+median_sorted(const std::vector<double>& xx, std::vector<double> w)
 {
-    utils::check_sizes(x, x, weights);
-    size_t n = x.size();
-
-    // sort x and weights in x order
-    auto perm = utils::get_order(x);
-    auto xx = x;
-    auto w = weights;
-    for (size_t i = 0; i < n; i++) {
-        xx[i] = x[perm[i]];
-        if (w.size() > 0)
-            w[i] = weights[perm[i]];
-    }
+    size_t n = xx.size();
 
     // compute weighted ranks and the "average rank" (corresponds to the
     // median)
-    auto ranks = rank0(xx, w, "average");
-    if (weights.size() == 0)
-        weights = std::vector<double>(n, 1.0);
-    double rank_avrg = utils::perm_sum(weights, 2) / utils::sum(weights);
+    std::vector<size_t> identity(n);
+    std::iota(identity.begin(), identity.end(), 0);
+    auto ranks = rank0_from_order(xx, identity, w, "average");
+    double rank_avrg = (n - 1) / 2.0;
+    if (w.size() > 0)
+        rank_avrg = utils::perm_sum(w, 2) / utils::sum(w);
 
     // weighted median splits data below and above rank_avrg
     size_t i = 0;
@@ -243,5 +454,18 @@ median(const std::vector<double>& x,
     else
         return 0.5 * (xx[i - 1] + xx[i]);
 }
+
+//! computes the (weighted) median of a vector.
+//! @param x the input vector.
+inline double
+median(const std::vector<double>& x,
+       std::vector<double> weights = std::vector<double>())
+{
+    utils::check_sizes(x, x, weights);
+
+    // sort x and weights in x order
+    auto perm = utils::get_order(x);
+    return median_sorted(utils::permute(x, perm), utils::permute(weights, perm));
+}
 }
 }
@@ -0,0 +1,353 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "eigen.hpp"
+#include <map>
+#include <utility>
+
+namespace wdm {
+
+//! a pair of variables together with their dependence measure.
+struct Screened_pair {
+    size_t i;      //!< column index of the first variable.
+    size_t j;      //!< column index of the second variable.
+    double value;  //!< the (exact) dependence measure.
+};
+
+namespace impl {
+
+//! computes a matrix of weighted Spearman's rho on the complete rows of `x`.
+//! @param x input data.
+//! @param weights an optional vector of weights for the data.
+inline Eigen::MatrixXd spearman_matrix(const Eigen::MatrixXd& x,
+                                       const Eigen::VectorXd& weights)
+{
+    // restrict to rows without missing values
+    std::vector<size_t> rows;
+    for (size_t k = 0; k < static_cast<size_t>(x.rows()); k++) {
+        bool complete = !x.row(k).hasNaN();
+        if (weights.size() > 0)
+            complete = complete && !std::isnan(weights(k));
+        if (complete)
+            rows.push_back(k);
+    }
+    size_t n = rows.size(), d = x.cols();
+
+    std::vector<double> w;
+    Eigen::VectorXd ww = Eigen::VectorXd::Ones(n);
+    if (weights.size() > 0) {
+        w.resize(n);
+        for (size_t k = 0; k < n; k++)
+            ww(k) = w[k] = weights(rows[k]);
+    }
+
+    // weighted (average) ranks, centered with respect to the weights
+    Eigen::MatrixXd r(n, d);
+    std::vector<double> col(n);
+    for (size_t j = 0; j < d; j++) {
+        for (size_t k = 0; k < n; k++)
+            col[k] = x(rows[k], j);
+        col = rank0(col, w, "average");
+        for (size_t k = 0; k < n; k++)
+            r(k, j) = col[k];
+    }
+    Eigen::RowVectorXd mu = (ww.transpose() * r) / ww.sum();
+    r.rowwise() -= mu;
+
+    // weighted Pearson correlation of the ranks
+    Eigen::MatrixXd cov = r.transpose() * ww.asDiagonal() * r;
+    Eigen::VectorXd sd = cov.diagonal().cwiseSqrt();
+    return cov.cwiseQuotient(sd * sd.transpose());
+}
+
+//! computes a cheap proxy for the matrix of dependence measures.
+//! @param x input data.
+//! @param method the dependence measure.
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing passed on to `wdm()`.
+//! @param proxy either `"rank"` or `"subsample"`.
+//! @param subsample_size number of rows used by the `"subsample"` proxy.
+inline Eigen::MatrixXd screening_proxy(const Eigen::MatrixXd& x,
+                                       std::string method,
+                                       const Eigen::VectorXd& weights,
+                                       bool remove_missing,
+                                       std::string proxy,
+                                       size_t subsample_size)
+{
+    size_t n = x.rows(), d = x.cols();
+    if (proxy == "subsample") {
+        if (subsample_size >= n)
+            return wdm(x, method, weights, remove_missing);
+        // deterministic, evenly spread subsample of the rows
+        Eigen::MatrixXd xs(subsample_size, d);
+        Eigen::VectorXd ws(weights.size() > 0 ? subsample_size : 0);
+        for (size_t k = 0; k < subsample_size; k++) {
+            size_t row = k * n / subsample_size;
+            xs.row(k) = x.row(row);
+            if (weights.size() > 0)
+                ws(k) = weights(row);
+        }
+        return wdm(xs, method, ws, remove_missing);
+    } else if (proxy != "rank") {
+        throw std::runtime_error("proxy must be either 'rank' or 'subsample'.");
+    }
+
+    Eigen::MatrixXd rho = spearman_matrix(x, weights);
+    if (methods::is_spearman(method))
+        return rho;
+    if (methods::is_kendall(method) || methods::is_blomqvist(method) ||
+        methods::is_pearson(method)) {
+        // relations between the measures under a Gaussian copula
+        const double pi = std::acos(-1);
+        Eigen::MatrixXd r = (rho * pi / 6).array().sin() * 2;
+        if (methods::is_pearson(method))
+            return r;
+        return r.array().asin() * 2 / pi;
+    }
+    throw std::runtime_error("the 'rank' proxy is only available for "
+                             "monotone dependence measures; use 'subsample'.");
+}
+
+//! resolves the `"auto"` proxy to the proxy appropriate for a method.
+inline std::string resolve_proxy(std::string proxy, std::string method)
+{
+    if (proxy != "auto")
+        return proxy;
+    bool monotone = !methods::is_hoeffding(method) &&
+        !methods::is_distance(method) && !methods::is_xi(method);
+    return monotone ? "rank" : "subsample";
+}
+
+//! chooses the slack of `screen()` for a method and proxy.
+//!
+//! For the `"subsample"` proxy, the slack is three times the standard error
+//! of the measure at `subsample_size` rows; for Hoeffding's \f$ D \f$, the
+//! standard error is evaluated at the level of the threshold, since it
+//! grows with the strength of dependence. The `"rank"` proxy relies on
+//! a model rather than sampling, and gets a fixed slack of 0.1.
+//! @param method the dependence measure.
+//! @param proxy the (resolved) proxy.
+//! @param threshold the screening threshold.
+//! @param subsample_size number of rows used by the proxy.
+inline double screening_slack(std::string method,
+                              std::string proxy,
+                              double threshold,
+                              size_t subsample_size)
+{
+    if (proxy != "subsample")
+        return 0.1;
+    // approximate upper bounds on sqrt(n) times the standard deviation of
+    // the measures (based on simulations from Gaussian copulas)
+    double sd;
+    if (methods::is_hoeffding(method)) {
+        sd = std::min(0.5, 1.1 * std::sqrt(std::max(threshold, 0.0)));
+    } else if (methods::is_kendall(method) || methods::is_xi(method)) {
+        sd = 0.7;
+    } else if (methods::is_distance(method)) {
+        sd = 0.8;
+    } else {
+        sd = 1.0;
+    }
+    return 3.0 * sd / std::sqrt(static_cast<double>(std::max(subsample_size,
+                                                             size_t(1))));
+}
+
+}
+
+//! screens all pairs of variables for strong dependence.
+//!
+//! A cheap proxy of the dependence measure is computed for all pairs first;
+//! the exact measure is only evaluated for pairs whose proxy exceeds
+//! `threshold - slack` in absolute value.
+//!
+//! @param x input data.
+//! @param method the dependence measure; see `wdm()` for possible values.
+//! @param threshold only pairs with absolute dependence of at least
+//!    `threshold` are returned.
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed; otherwise throws an error if `nan`s are present.
+//! @param slack tolerance for the proxy; larger values make the screening
+//!    more reliable but less selective. Negative values (default) choose the
+//!    slack from the method and proxy: three standard errors of the measure
+//!    at `subsample_size` rows for the `"subsample"` proxy and 0.1 for the
+//!    `"rank"` proxy.
+//! @param proxy the proxy used for screening; one of
+//!    - `"rank"`: Spearman's \f$ \rho \f$ mapped to the scale of `method`
+//!      using the relations that hold under a Gaussian copula (not available
+//!      for Hoeffding's \f$ D \f$, the distance correlation, and
+//!      Chatterjee's \f$ \xi \f$),
+//!    - `"subsample"`: the exact measure computed on an evenly spread
+//!      subsample of the rows,
+//!    - `"auto"` (default): `"subsample"` for Hoeffding's \f$ D \f$, the
+//!      distance correlation, and Chatterjee's \f$ \xi \f$ and `"rank"`
+//!      otherwise.
+//! @param subsample_size number of rows used by the `"subsample"` proxy.
+//! @param num_threads number of threads used for the exact measures; `0`
+//!    (default) uses all available cores.
+//!
+//! @details
+//! The proxies are heuristics and not rigorous bounds; pairs with a strong
+//! dependence that is poorly reflected by the proxy can be missed unless
+//! `slack` is large enough.
+//!
+//! @return a list of all pairs \f$ i < j \f$ (all pairs \f$ i \neq j \f$
+//!    for measures that are not symmetric) with dependence above the
+//!    threshold.
+inline std::vector<Screened_pair> screen(const Eigen::MatrixXd& x,
+                                         std::string method,
+                                         double threshold,
+                                         Eigen::VectorXd weights = Eigen::VectorXd(),
+                                         bool remove_missing = true,
+                                         double slack = -1.0,
+                                         std::string proxy = "auto",
+                                         size_t subsample_size = 1000,
+                                         size_t num_threads = 0)
+{
+    size_t d = x.cols();
+    if (d < 2)
+        throw std::runtime_error("x must have at least 2 columns.");
+    proxy = impl::resolve_proxy(proxy, method);
+    Eigen::MatrixXd pm = impl::screening_proxy(
+        x, method, weights, remove_missing, proxy, subsample_size);
+    if (slack < 0)
+        slack = impl::screening_slack(method, proxy, threshold,
+                                      std::min(subsample_size,
+                                               static_cast<size_t>(x.rows())));
+
+    // for measures that are not symmetric, both orders of a pair are screened
+    bool symmetric = methods::is_symmetric(method);
+    std::vector<Screened_pair> cand;
+    for (size_t i = 0; i < d; i++) {
+        for (size_t j = symmetric ? i + 1 : 0; j < d; j++) {
+            if (j == i)
+                continue;
+            // missing proxies are treated conservatively as strong dependence
+            double p = std::abs(pm(i, j));
+            if ((p < threshold - slack) && !std::isnan(p))
+                continue;
+            cand.push_back({i, j, 0.0});
+        }
+    }
+
+    auto w = utils::convert_vec(weights);
+    utils::parallel_for(cand.size(), num_threads, [&] (size_t k, size_t) {
+        cand[k].value = wdm(utils::convert_vec(x.col(cand[k].i)),
+                            utils::convert_vec(x.col(cand[k].j)),
+                            method, w, remove_missing);
+    });
+
+    std::vector<Screened_pair> pairs;
+    for (const auto& pair : cand) {
+        if (std::abs(pair.value) >= threshold)
+            pairs.push_back(pair);
+    }
+
+    return pairs;
+}
+
+//! screens for the `k` strongest partners of every variable.
+//!
+//! For every column `i`, a cheap proxy is used to select the
+//! `k * oversampling` most promising partners; the exact measure is computed
+//! for those and the `k` strongest are returned.
+//!
+//! @param x input data.
+//! @param method the dependence measure; see `wdm()` for possible values.
+//! @param k the number of partners per variable.
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed; otherwise throws an error if `nan`s are present.
+//! @param oversampling factor by which the number of candidates exceeds `k`.
+//! @param proxy the proxy used for screening; see `screen()`.
+//! @param subsample_size number of rows used by the `"subsample"` proxy.
+//! @param num_threads number of threads used for the exact measures; `0`
+//!    (default) uses all available cores.
+//!
+//! @return a list containing, for each column `i` in turn, the pairs
+//!    `(i, j)` sorted by decreasing absolute dependence.
+inline std::vector<Screened_pair> screen_top_k(const Eigen::MatrixXd& x,
+                                               std::string method,
+                                               size_t k,
+                                               Eigen::VectorXd weights = Eigen::VectorXd(),
+                                               bool remove_missing = true,
+                                               size_t oversampling = 3,
+                                               std::string proxy = "auto",
+                                               size_t subsample_size = 1000,
+                                               size_t num_threads = 0)
+{
+    size_t d = x.cols();
+    if (d < 2)
+        throw std::runtime_error("x must have at least 2 columns.");
+    proxy = impl::resolve_proxy(proxy, method);
+    Eigen::MatrixXd pm = impl::screening_proxy(
+        x, method, weights, remove_missing, proxy, subsample_size);
+
+    size_t num_cand = std::min(d - 1, std::max(k, k * oversampling));
+    k = std::min(k, d - 1);
+
+    // the candidates of all columns are collected first, so that the exact
+    // values can be computed in parallel; (i, j) and (j, i) may both be
+    // candidates (and coincide for symmetric measures)
+    bool symmetric = methods::is_symmetric(method);
+    auto key = [symmetric] (size_t i, size_t j) {
+        return symmetric ? std::make_pair(std::min(i, j), std::max(i, j))
+                         : std::make_pair(i, j);
+    };
+    std::vector<std::vector<size_t>> cands(d);
+    std::map<std::pair<size_t, size_t>, double> exact;
+    for (size_t i = 0; i < d; i++) {
+        auto& cand = cands[i];
+        for (size_t j = 0; j < d; j++) {
+            if (j != i)
+                cand.push_back(j);
+        }
+        // missing proxies are treated conservatively as strong dependence
+        auto strength = [&] (size_t j) {
+            double p = std::abs(pm(i, j));
+            return std::isnan(p) ? std::numeric_limits<double>::infinity() : p;
+        };
+        auto by_proxy = [&] (size_t a, size_t b) {
+            return strength(a) > strength(b);
+        };
+        std::partial_sort(cand.begin(), cand.begin() + num_cand, cand.end(),
+                          by_proxy);
+        cand.resize(num_cand);
+        for (size_t j : cand)
+            exact[key(i, j)] = 0.0;
+    }
+
+    std::vector<std::map<std::pair<size_t, size_t>, double>::iterator> todo;
+    for (auto it = exact.begin(); it != exact.end(); ++it)
+        todo.push_back(it);
+    auto w = utils::convert_vec(weights);
+    utils::parallel_for(todo.size(), num_threads, [&] (size_t k, size_t) {
+        todo[k]->second = wdm(utils::convert_vec(x.col(todo[k]->first.first)),
+                              utils::convert_vec(x.col(todo[k]->first.second)),
+                              method, w, remove_missing);
+    });
+
+    std::vector<Screened_pair> pairs;
+    std::vector<Screened_pair> top;
+    auto by_value = [] (const Screened_pair& a, const Screened_pair& b) {
+        double va = std::isnan(a.value) ? -1.0 : std::abs(a.value);
+        double vb = std::isnan(b.value) ? -1.0 : std::abs(b.value);
+        return va > vb;
+    };
+    for (size_t i = 0; i < d; i++) {
+        top.clear();
+        for (size_t j : cands[i])
+            top.push_back({i, j, exact[key(i, j)]});
+        std::partial_sort(top.begin(), top.begin() + k, top.end(), by_value);
+        pairs.insert(pairs.end(), top.begin(), top.begin() + k);
+    }
+
+    return pairs;
+}
+
+}
@@ -0,0 +1,123 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "utils.hpp"
+#include "prho.hpp"
+
+namespace wdm {
+
+namespace impl {
+
+//! largest sample size for which the kernels below are used; for such
+//! samples, comparing all pairs is faster than sorting.
+const size_t small_n_max = 64;
+
+//! computes ranks (such that the smallest element has rank 0) of a small
+//! sample by comparing all pairs.
+//! @param x pointer to the input data.
+//! @param weights pointer to the weights; `nullptr` stands for unit weights.
+//! @param n the number of observations (at most `small_n_max`).
+//! @param average whether ties get the average (or the minimum) rank.
+//! @param ranks pointer to the output.
+inline void rank0_small(const double* x,
+                        const double* weights,
+                        size_t n,
+                        bool average,
+                        double* ranks)
+{
+    if (!weights) {
+        for (size_t i = 0; i < n; i++) {
+            size_t below = 0, tied = 0;
+            for (size_t j = 0; j < n; j++) {
+                below += (x[j] < x[i]);
+                tied += (x[j] == x[i]);
+            }
+            ranks[i] = static_cast<double>(below);
+            if (average)
+                ranks[i] += (static_cast<double>(tied) - 1) / 2;
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        // weight of smaller and tied observations
+        double w_below = 0.0, w1 = 0.0, w2 = 0.0;
+        for (size_t j = 0; j < n; j++) {
+            double below = (x[j] < x[i]), tied = (x[j] == x[i]);
+            w_below += below * weights[j];
+            w1 += tied * weights[j];
+            w2 += tied * weights[j] * weights[j];
+        }
+        ranks[i] = w_below;
+        if (average)
+            ranks[i] += (w1 * w1 - w2) / (2 * w1);
+    }
+}
+
+//! calculates the (weighted) Kendall's tau of a small sample by comparing
+//! all pairs.
+//! @param x, y pointers to the input data.
+//! @param weights pointer to the weights; `nullptr` stands for unit weights.
+//! @param n the number of observations.
+inline double ktau_small(const double* x,
+                         const double* y,
+                         const double* weights,
+                         size_t n)
+{
+    double num_pairs, num_cd, ties_x, ties_y;
+    if (weights) {
+        num_pairs = num_cd = ties_x = ties_y = 0.0;
+        for (size_t i = 1; i < n; i++) {
+            for (size_t j = 0; j < i; j++) {
+                double w = weights[i] * weights[j];
+                int sx = (x[i] > x[j]) - (x[i] < x[j]);
+                int sy = (y[i] > y[j]) - (y[i] < y[j]);
+                num_cd += w * (sx * sy);
+                num_pairs += w;
+                ties_x += w * (sx == 0);
+                ties_y += w * (sy == 0);
+            }
+        }
+    } else {
+        int64_t cd = 0, tx = 0, ty = 0;
+        for (size_t i = 1; i < n; i++) {
+            for (size_t j = 0; j < i; j++) {
+                int sx = (x[i] > x[j]) - (x[i] < x[j]);
+                int sy = (y[i] > y[j]) - (y[i] < y[j]);
+                cd += sx * sy;
+                tx += (sx == 0);
+                ty += (sy == 0);
+            }
+        }
+        num_pairs = static_cast<double>(n * (n - 1) / 2);
+        num_cd = static_cast<double>(cd);
+        ties_x = static_cast<double>(tx);
+        ties_y = static_cast<double>(ty);
+    }
+
+    return num_cd / std::sqrt((num_pairs - ties_x) * (num_pairs - ties_y));
+}
+
+//! calculates the (weighted) Spearman's rho of a small sample.
+//! @param x, y pointers to the input data.
+//! @param weights pointer to the weights; `nullptr` stands for unit weights.
+//! @param n the number of observations (at most `small_n_max`).
+inline double srho_small(const double* x,
+                         const double* y,
+                         const double* weights,
+                         size_t n)
+{
+    double rx[small_n_max], ry[small_n_max];
+    rank0_small(x, weights, n, true, rx);
+    rank0_small(y, weights, n, true, ry);
+    return prho_raw(rx, ry, weights, n);
+}
+
+}
+
+}
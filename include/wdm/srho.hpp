@@ -9,6 +9,7 @@
 #include "utils.hpp"
 #include "ranks.hpp"
 #include "prho.hpp"
+#include "small.hpp"
 
 namespace wdm {
     
@@ -21,12 +22,116 @@ inline double srho(std::vector<double> x,
                    std::vector<double> y,
                    std::vector<double> weights = std::vector<double>())
 {
+    WDM_PROFILE_SCOPE("srho", x.size());
     utils::check_sizes(x, y, weights);
+    if (x.size() <= small_n_max) {
+        return srho_small(x.data(), y.data(),
+                          weights.size() > 0 ? weights.data() : nullptr,
+                          x.size());
+    }
     x = rank0(x, weights, "average");
     y = rank0(y, weights, "average");
     return prho(x, y, weights);
 }
 
+//! largest sample size for which `Indep_test` uses the null distribution of
+//! the unweighted Spearman's rho (without ties) below.
+const size_t srho_exact_n_max = 50;
+
+//! largest sample size for which the null distribution of Spearman's rho is
+//! obtained by enumerating all permutations.
+const size_t srho_enum_n_max = 9;
+
+//! cumulative null distributions of the sum of squared rank differences.
+//!
+//! Element `n` holds \f$ P(S \le 2h) \f$, \f$ h = 0, \dots, (n^3 - n) / 6 \f$,
+//! for \f$ S = \sum_i (r_i - i)^2 \f$ and a random permutation
+//! \f$ r \f$ of size \f$ n \le \f$ `srho_enum_n_max` (\f$ S \f$ is always
+//! even). The tables are built once, on first use, by enumerating all
+//! permutations; initialization of the static is thread-safe.
+inline const std::vector<std::vector<double>>& srho_null_table()
+{
+    static const std::vector<std::vector<double>> table = [] {
+        std::vector<std::vector<double>> cdf(srho_enum_n_max + 1);
+        for (size_t n = 1; n <= srho_enum_n_max; n++) {
+            std::vector<double> counts((n * n * n - n) / 6 + 1, 0.0);
+            std::vector<int> r(n);
+            std::iota(r.begin(), r.end(), 0);
+            double num_perms = 0.0;
+            do {
+                int s = 0;
+                for (int i = 0; i < static_cast<int>(n); i++)
+                    s += (r[i] - i) * (r[i] - i);
+                counts[s / 2]++;
+                num_perms++;
+            } while (std::next_permutation(r.begin(), r.end()));
+            cdf[n].resize(counts.size());
+            std::partial_sum(counts.begin(), counts.end(), cdf[n].begin());
+            for (auto& c : cdf[n])
+                c /= num_perms;
+        }
+        cdf[0] = cdf[1];
+        return cdf;
+    }();
+
+    return table;
+}
+
+//! computes \f$ P(S \ge s) \f$ for the sum of squared rank differences by an
+//! Edgeworth series expansion (Best and Roberts, 1975, Algorithm AS 89).
+//! @param s the observed sum of squared rank differences.
+//! @param n the sample size.
+inline double psrho_edgeworth(double s, size_t n)
+{
+    const double c1 = 0.2274, c2 = 0.2531, c3 = 0.1745, c4 = 0.0758,
+        c5 = 0.1033, c6 = 0.3932, c7 = 0.0879, c8 = 0.0151, c9 = 0.0072,
+        c10 = 0.0831, c11 = 0.0131, c12 = 4.6e-4;
+    double nn = static_cast<double>(n);
+    double b = 1 / nn;
+    double x = (6 * (s - 1) * b / (nn * nn - 1) - 1) * std::sqrt(1 / b - 1);
+    double y = x * x;
+    double u = x * b * (c1 + b * (c2 + c3 * b) + y * (-c4 + b * (c5 + c6 * b) -
+        y * b * (c7 + c8 * b - y * (c9 - c10 * b + y * b * (c11 - c12 * y)))));
+    double p = u / std::exp(y / 2) + utils::normalCDF(-x);
+
+    return std::min(std::max(p, 0.0), 1.0);
+}
+
+//! computes the p-value of the test based on the unweighted Spearman's rho
+//! for data without ties; exact for samples of size at most
+//! `srho_enum_n_max` and based on an Edgeworth series otherwise.
+//! @param rho the estimate.
+//! @param n the sample size.
+//! @param alternative `"two-sided"`, `"greater"`, or `"less"`.
+inline double psrho_exact(double rho, size_t n, const std::string& alternative)
+{
+    // the distribution of S is symmetric around (n^3 - n) / 6
+    double nn = static_cast<double>(n);
+    double s_max = (nn * nn * nn - nn) / 3;
+    double s = 2 * std::round((1 - rho) * s_max / 4);
+    s = std::min(std::max(s, 0.0), s_max);
+
+    double p_greater, p_less;
+    if (n <= srho_enum_n_max) {
+        const auto& cdf = srho_null_table()[n];
+        size_t h = static_cast<size_t>(s / 2);
+        p_greater = cdf[h];
+        p_less = cdf[cdf.size() - 1 - h];
+    } else {
+        p_greater = psrho_edgeworth(s_max - s, n);
+        p_less = psrho_edgeworth(s, n);
+    }
+
+    if (alternative == "two-sided") {
+        return std::min(1.0, 2 * std::min(p_greater, p_less));
+    } else if (alternative == "greater") {
+        return p_greater;
+    } else if (alternative == "less") {
+        return p_less;
+    }
+    throw std::runtime_error("alternative not implemented.");
+}
+
 }
 
 }
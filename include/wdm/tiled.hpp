@@ -0,0 +1,212 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "eigen.hpp"
+#include "tiles.hpp"
+#include <cstring>
+#include <fstream>
+
+namespace wdm {
+
+namespace impl {
+
+//! header of the tiled file format; the values start at byte
+//! `tiled_header_size` in native byte order.
+const char tiled_magic[8] = {'W', 'D', 'M', 'T', 'I', 'L', 'E', '1'};
+const size_t tiled_header_size = 64;
+
+//! fields of the header following the magic number.
+struct Tiled_header {
+    uint64_t d;
+    uint64_t tile_size;
+    uint64_t symmetric;
+    uint64_t value_bytes;
+};
+
+}
+
+//! calculates a matrix of (weighted) dependence measures tile by tile.
+//!
+//! The variables are split into blocks of `tile_size`; for symmetric
+//! measures, only the tiles in the upper triangle are computed (see
+//! `Tile_layout`). Each tile is passed to `sink` as soon as it is complete,
+//! so that memory is bounded by the size of a tile instead of the full
+//! \f$ d \times d \f$ matrix.
+//!
+//! @param x input data.
+//! @param method the dependence measure; see `wdm()` for possible values.
+//! @param sink a function called with each tile (from the calling thread, in
+//!    the order of `Tile_layout`).
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed (separately for each pair); otherwise throws an error if `nan`s
+//!    are present.
+//! @param tile_size number of variables per block.
+//! @param num_threads number of threads used within each tile; `0`
+//!    (default) uses all available cores.
+//! @details
+//! Diagonal tiles are complete (both triangles and a unit diagonal). For
+//! measures that are not symmetric (Chatterjee's \f$ \xi \f$), all tiles are
+//! computed and the entry `(i, j)` is the measure with `x.col(i)` as first
+//! and `x.col(j)` as second argument.
+inline void wdm_tiled(const Eigen::MatrixXd& x,
+                      std::string method,
+                      const std::function<void(const Matrix_tile&)>& sink,
+                      Eigen::VectorXd weights = Eigen::VectorXd(),
+                      bool remove_missing = true,
+                      size_t tile_size = 512,
+                      size_t num_threads = 0)
+{
+    impl::wdm_tiles([&x] (size_t j) { return utils::convert_vec(x.col(j)); },
+                    x.rows(), x.cols(), method, utils::convert_vec(weights),
+                    remove_missing, tile_size, num_threads, sink);
+}
+
+namespace impl {
+
+//! writes the header of a tiled file.
+inline void write_tiled_header(std::ofstream& file,
+                               const Tile_layout& layout,
+                               size_t value_bytes)
+{
+    Tiled_header header{layout.d, layout.tile_size, layout.symmetric,
+                        value_bytes};
+    char buf[tiled_header_size] = {};
+    std::memcpy(buf, tiled_magic, sizeof(tiled_magic));
+    std::memcpy(buf + sizeof(tiled_magic), &header, sizeof(header));
+    file.write(buf, tiled_header_size);
+}
+
+//! writes a matrix of dependence measures to a tiled file.
+//! @param path the file.
+//! @param single_precision whether values are stored as `float`.
+//! @param other arguments see `wdm_tiles()`.
+inline void write_tiles(const Column_source& column,
+                        size_t n,
+                        size_t d,
+                        std::string method,
+                        const std::vector<double>& weights,
+                        bool remove_missing,
+                        size_t tile_size,
+                        size_t num_threads,
+                        std::string path,
+                        bool single_precision)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("cannot open '" + path + "' for writing.");
+    Tile_layout layout{d, tile_size, methods::is_symmetric(method)};
+    write_tiled_header(file, layout, single_precision ? 4 : 8);
+
+    std::vector<float> buf;
+    auto sink = [&] (const Matrix_tile& tile) {
+        if (single_precision) {
+            buf.assign(tile.values.begin(), tile.values.end());
+            file.write(reinterpret_cast<const char*>(buf.data()),
+                       buf.size() * sizeof(float));
+        } else {
+            file.write(reinterpret_cast<const char*>(tile.values.data()),
+                       tile.values.size() * sizeof(double));
+        }
+        if (!file)
+            throw std::runtime_error("writing to '" + path + "' failed.");
+    };
+    wdm_tiles(column, n, d, method, weights, remove_missing, tile_size,
+              num_threads, sink);
+}
+
+}
+
+//! calculates a matrix of (weighted) dependence measures and writes it tile
+//! by tile to a binary file.
+//!
+//! The file starts with a header of 64 bytes: the magic number `WDMTILE1`
+//! followed by the number of variables, the tile size, whether only the
+//! upper triangle is stored, and the number of bytes per value (each as
+//! `uint64_t`). The values follow in native byte order and in the order
+//! described by `Tile_layout`; the file can hence be memory-mapped and
+//! entry `(i, j)` read at position `Tile_layout::index(i, j)`.
+//!
+//! @param x input data.
+//! @param method the dependence measure; see `wdm()` for possible values.
+//! @param path the output file; overwritten if it exists.
+//! @param weights an optional vector of weights for the data.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed (separately for each pair); otherwise throws an error if `nan`s
+//!    are present.
+//! @param single_precision whether values are stored as `float` (halving the
+//!    file size) instead of `double`.
+//! @param tile_size number of variables per block.
+//! @param num_threads number of threads used within each tile; `0`
+//!    (default) uses all available cores.
+inline void wdm_tiled(const Eigen::MatrixXd& x,
+                      std::string method,
+                      std::string path,
+                      Eigen::VectorXd weights = Eigen::VectorXd(),
+                      bool remove_missing = true,
+                      bool single_precision = false,
+                      size_t tile_size = 512,
+                      size_t num_threads = 0)
+{
+    impl::write_tiles([&x] (size_t j) { return utils::convert_vec(x.col(j)); },
+                      x.rows(), x.cols(), method, utils::convert_vec(weights),
+                      remove_missing, tile_size, num_threads, path,
+                      single_precision);
+}
+
+//! reads the layout of a tiled file written by `wdm_tiled()`.
+//! @param path the file.
+//! @param value_bytes on exit, the number of bytes per value (4 or 8).
+inline Tile_layout read_tiled_layout(std::string path, size_t& value_bytes)
+{
+    std::ifstream file(path, std::ios::binary);
+    char buf[impl::tiled_header_size];
+    if (!file || !file.read(buf, impl::tiled_header_size))
+        throw std::runtime_error("cannot read '" + path + "'.");
+    if (std::memcmp(buf, impl::tiled_magic, sizeof(impl::tiled_magic)) != 0)
+        throw std::runtime_error("'" + path + "' is not a tiled matrix file.");
+    impl::Tiled_header header;
+    std::memcpy(&header, buf + sizeof(impl::tiled_magic), sizeof(header));
+    value_bytes = header.value_bytes;
+    return Tile_layout{header.d, header.tile_size, header.symmetric != 0};
+}
+
+//! reads a tiled file written by `wdm_tiled()` into a dense matrix.
+//! @param path the file.
+inline Eigen::MatrixXd read_tiled(std::string path)
+{
+    size_t value_bytes;
+    Tile_layout layout = read_tiled_layout(path, value_bytes);
+    if ((value_bytes != 4) && (value_bytes != 8))
+        throw std::runtime_error("'" + path + "' has an invalid value size.");
+
+    std::ifstream file(path, std::ios::binary);
+    file.seekg(impl::tiled_header_size);
+    std::vector<char> buf(layout.size() * value_bytes);
+    if (!file.read(buf.data(), buf.size()))
+        throw std::runtime_error("'" + path + "' is truncated.");
+    auto value = [&] (size_t k) {
+        if (value_bytes == 4) {
+            float v;
+            std::memcpy(&v, &buf[k * 4], 4);
+            return static_cast<double>(v);
+        }
+        double v;
+        std::memcpy(&v, &buf[k * 8], 8);
+        return v;
+    };
+
+    Eigen::MatrixXd ms(layout.d, layout.d);
+    for (size_t i = 0; i < layout.d; i++) {
+        for (size_t j = 0; j < layout.d; j++)
+            ms(i, j) = value(layout.index(i, j));
+    }
+    return ms;
+}
+
+}
@@ -0,0 +1,285 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "../wdm.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace wdm {
+
+//! a rectangular block of a matrix of dependence measures.
+struct Matrix_tile {
+    size_t row_begin;            //!< first row of the tile.
+    size_t row_end;              //!< one past the last row of the tile.
+    size_t col_begin;            //!< first column of the tile.
+    size_t col_end;              //!< one past the last column of the tile.
+    std::vector<double> values;  //!< the entries of the tile in row-major order.
+
+    //! the entry `(i, j)` of the full matrix.
+    double operator()(size_t i, size_t j) const
+    {
+        return values[(i - row_begin) * (col_end - col_begin) + (j - col_begin)];
+    }
+};
+
+//! layout of a matrix of dependence measures stored tile by tile.
+//!
+//! The variables are split into blocks of `tile_size` (the last block may be
+//! smaller). Tiles are stored in row-major order of the blocks, each tile in
+//! row-major order of its entries. For symmetric measures, only the tiles in
+//! the upper triangle (including the diagonal tiles, which are stored in
+//! full) are kept; the entry `(i, j)` with `i > j` is found at `(j, i)`.
+struct Tile_layout {
+    size_t d;          //!< number of variables.
+    size_t tile_size;  //!< number of variables per block.
+    bool symmetric;    //!< whether only the upper triangle is stored.
+
+    //! the number of blocks.
+    size_t num_blocks() const
+    {
+        return (d + tile_size - 1) / tile_size;
+    }
+
+    //! the number of variables in block `b`.
+    size_t block_size(size_t b) const
+    {
+        return std::min(tile_size, d - b * tile_size);
+    }
+
+    //! the first block in a row of tiles.
+    size_t first_block(size_t bi) const
+    {
+        return symmetric ? bi : 0;
+    }
+
+    //! the number of values stored before tile `(bi, bj)`.
+    size_t tile_offset(size_t bi, size_t bj) const
+    {
+        // all blocks but the last are full, so the row offset is a sum over
+        // full rows of tiles
+        size_t offset = 0;
+        if (symmetric) {
+            offset = tile_size * (bi * d - tile_size * bi * (bi - (bi > 0)) / 2);
+        } else {
+            offset = bi * tile_size * d;
+        }
+        return offset + block_size(bi) * (bj - first_block(bi)) * tile_size;
+    }
+
+    //! the total number of values stored.
+    size_t size() const
+    {
+        size_t b = num_blocks() - 1;
+        return tile_offset(b, first_block(b)) +
+            block_size(b) * (d - first_block(b) * tile_size);
+    }
+
+    //! the position of entry `(i, j)` in the stored values.
+    size_t index(size_t i, size_t j) const
+    {
+        if (symmetric && (i > j))
+            std::swap(i, j);
+        size_t bi = i / tile_size, bj = j / tile_size;
+        return tile_offset(bi, bj) +
+            (i - bi * tile_size) * block_size(bj) + (j - bj * tile_size);
+    }
+};
+
+namespace impl {
+
+//! a function returning column `j` of the input data.
+using Column_source = std::function<std::vector<double>(size_t)>;
+
+//! calculates all tiles of a matrix of dependence measures.
+//!
+//! Tiles are computed one after another (the pairs of a tile in parallel) and
+//! passed to `sink` in the order of `Tile_layout`, so that at most one tile
+//! and the columns of two blocks are held in memory. Marginal quantities are
+//! shared within a tile.
+//! @param column the input columns.
+//! @param n, d number of observations and variables.
+//! @param method the dependence measure.
+//! @param weights vector of weights for the data; can be empty.
+//! @param remove_missing see `wdm()`.
+//! @param tile_size number of variables per block.
+//! @param num_threads number of threads.
+//! @param sink called for each tile.
+inline void wdm_tiles(const Column_source& column,
+                      size_t n,
+                      size_t d,
+                      std::string method,
+                      const std::vector<double>& weights,
+                      bool remove_missing,
+                      size_t tile_size,
+                      size_t num_threads,
+                      const std::function<void(const Matrix_tile&)>& sink)
+{
+    WDM_PROFILE_SCOPE("matrix", n * d);
+    if (d < 2)
+        throw std::runtime_error("x must have at least 2 columns.");
+    if (tile_size == 0)
+        throw std::runtime_error("tile_size must be positive.");
+    if ((weights.size() > 0) && (weights.size() != n))
+        throw std::runtime_error("weights and data must have same size.");
+    if (!methods::is_hoeffding(method) && !methods::is_kendall(method) &&
+        !methods::is_pearson(method) && !methods::is_spearman(method) &&
+        !methods::is_blomqvist(method) && !methods::is_distance(method) &&
+        !methods::is_xi(method))
+        throw std::runtime_error("method not implemented.");
+
+    Tile_layout layout{d, tile_size, methods::is_symmetric(method)};
+    size_t num_blocks = layout.num_blocks();
+    auto get_block = [&] (size_t b) {
+        std::vector<std::vector<double>> cols(layout.block_size(b));
+        for (size_t k = 0; k < cols.size(); k++) {
+            cols[k] = column(b * tile_size + k);
+            if (cols[k].size() != n)
+                throw std::runtime_error("all columns must have size n.");
+        }
+        return cols;
+    };
+    auto has_nan = [] (const std::vector<std::vector<double>>& cols) {
+        for (const auto& col : cols) {
+            if (utils::any_nan(col))
+                return true;
+        }
+        return false;
+    };
+    uint64_t xi_key = random::make_key(xi_default_seeds());
+
+    for (size_t bi = 0; bi < num_blocks; bi++) {
+        auto rows = get_block(bi);
+        for (size_t bj = layout.first_block(bi); bj < num_blocks; bj++) {
+            std::vector<std::vector<double>> other;
+            if (bj != bi)
+                other = get_block(bj);
+            const auto& cols = (bj == bi) ? rows : other;
+            Matrix_tile tile;
+            tile.row_begin = bi * tile_size;
+            tile.row_end = tile.row_begin + rows.size();
+            tile.col_begin = bj * tile_size;
+            tile.col_end = tile.col_begin + cols.size();
+            size_t m = cols.size();
+            tile.values.assign(rows.size() * m, 1.0);
+
+            // without missing values, all pairs share the same sample
+            bool shared = !has_nan(rows) && !has_nan(cols) &&
+                !utils::any_nan(weights) &&
+                (n >= methods::get_min_nobs(method));
+            std::vector<Dcor_margin> margins_x, margins_y;
+            if (shared && methods::is_distance(method)) {
+                margins_x.resize(rows.size());
+                margins_y.resize(m);
+                utils::parallel_for(rows.size(), num_threads, [&] (size_t k, size_t) {
+                    margins_x[k] = dcor_margin(rows[k], weights,
+                                               utils::get_order(rows[k]));
+                });
+                utils::parallel_for(m, num_threads, [&] (size_t k, size_t) {
+                    margins_y[k] = dcor_margin(cols[k], weights,
+                                               utils::get_order(cols[k]));
+                });
+            }
+            std::vector<std::vector<size_t>> orders;
+            std::vector<Xi_response> responses;
+            if (shared && methods::is_xi(method)) {
+                orders.resize(rows.size());
+                responses.resize(m);
+                utils::parallel_for(rows.size(), num_threads, [&] (size_t k, size_t) {
+                    orders[k] = xi_order(rows[k], xi_key);
+                });
+                utils::parallel_for(m, num_threads, [&] (size_t k, size_t) {
+                    responses[k] = xi_response(cols[k], weights);
+                });
+            }
+
+            // on diagonal tiles of symmetric measures, only the upper
+            // triangle is computed
+            bool mirror = layout.symmetric && (bi == bj);
+            std::vector<std::pair<size_t, size_t>> pairs;
+            for (size_t k = 0; k < rows.size(); k++) {
+                for (size_t l = mirror ? k + 1 : 0; l < m; l++) {
+                    if ((bi != bj) || (k != l))
+                        pairs.push_back(std::make_pair(k, l));
+                }
+            }
+            utils::parallel_for(pairs.size(), num_threads, [&] (size_t p, size_t) {
+                size_t k = pairs[p].first, l = pairs[p].second;
+                double res;
+                if (shared && methods::is_distance(method)) {
+                    res = dcor_from_margins(margins_x[k], margins_y[l], weights);
+                } else if (shared && methods::is_xi(method)) {
+                    res = xi_from_order(orders[k], responses[l], weights);
+                } else {
+                    res = wdm(rows[k], cols[l], method, weights, remove_missing);
+                }
+                tile.values[k * m + l] = res;
+                if (mirror)
+                    tile.values[l * m + k] = res;
+            });
+
+            sink(tile);
+        }
+    }
+}
+
+//! calculates a matrix of (weighted) dependence measures from a strided
+//! buffer; the compiled and C libraries use this.
+//!
+//! The columns are copied once and computed as a single tile of
+//! `wdm_tiles()`, so that the pairs run in parallel and share the marginal
+//! quantities of each variable.
+//! @param x pointer to the data; observation `k` of variable `j` is
+//!   `x[k * row_stride + j * col_stride]`.
+//! @param n, d number of observations and variables.
+//! @param row_stride, col_stride distance between two consecutive rows and
+//!   columns.
+//! @param weights pointer to the weights of each row (contiguous); `nullptr`
+//!   stands for unit weights.
+//! @param method, remove_missing see `wdm()`.
+//! @param num_threads number of threads.
+//! @param out pointer to the result; the measure with variable `i` as first
+//!   and `j` as second argument is stored at
+//!   `out[i * out_row_stride + j * out_col_stride]`.
+//! @param out_row_stride, out_col_stride the layout of `out`.
+inline void wdm_matrix(const double* x,
+                       size_t n,
+                       size_t d,
+                       ptrdiff_t row_stride,
+                       ptrdiff_t col_stride,
+                       const double* weights,
+                       const std::string& method,
+                       bool remove_missing,
+                       size_t num_threads,
+                       double* out,
+                       size_t out_row_stride,
+                       size_t out_col_stride)
+{
+    Column_source column = [=] (size_t j) {
+        const double* xj = x + static_cast<ptrdiff_t>(j) * col_stride;
+        std::vector<double> col(n);
+        for (size_t k = 0; k < n; k++)
+            col[k] = xj[static_cast<ptrdiff_t>(k) * row_stride];
+        return col;
+    };
+    std::vector<double> w;
+    if (weights)
+        w.assign(weights, weights + n);
+
+    wdm_tiles(column, n, d, method, w, remove_missing, std::max(d, size_t(1)),
+              num_threads, [&] (const Matrix_tile& tile) {
+        for (size_t i = tile.row_begin; i < tile.row_end; i++) {
+            for (size_t j = tile.col_begin; j < tile.col_end; j++)
+                out[i * out_row_stride + j * out_col_stride] = tile(i, j);
+        }
+    });
+}
+
+}
+
+}
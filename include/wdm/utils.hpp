@@ -7,12 +7,15 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <numeric>
 #include <cmath>
 #include <stdexcept>
 
+#include "profiling.hpp"
+
 namespace wdm {
 
 namespace utils {
@@ -22,17 +25,29 @@ inline double normalCDF(double x)
     return std::erfc(-x / std::sqrt(2)) / 2;
 }
 
-inline double linear_interp(const double& x,
-                     const std::vector<double>& grid,
-                     const std::vector<double>& values)
+//! interpolates tabulated values linearly.
+//! @param x the point at which to interpolate; must lie within the grid.
+//! @param grid pointer to the grid points in ascending order.
+//! @param values pointer to the values at the grid points.
+//! @param m the number of grid points (at least 2).
+inline double linear_interp(double x,
+                            const double* grid,
+                            const double* values,
+                            size_t m)
 {
-    // find upper end point of interval
-    size_t i = 1;
-    while(x > grid[i]) i++;
+    // find upper end point of interval by binary search
+    size_t i = std::lower_bound(grid + 1, grid + m - 1, x) - grid;
 
     // linear interpolation
     double w = (x - grid[i - 1]) / (grid[i] - grid[i - 1]);
-    return w * values[i - 1] + (1 - w) * values[i];
+    return (1 - w) * values[i - 1] + w * values[i];
+}
+
+inline double linear_interp(const double& x,
+                     const std::vector<double>& grid,
+                     const std::vector<double>& values)
+{
+    return linear_interp(x, grid.data(), values.data(), grid.size());
 }
 
 inline void check_sizes(const std::vector<double>& x,
@@ -74,21 +89,84 @@ inline double sum(const std::vector<double>& x)
     return res;
 }
 
+//! checks whether a vector contains ties.
+//! @param x the input vector.
+inline bool has_ties(std::vector<double> x)
+{
+    std::sort(x.begin(), x.end());
+    return std::adjacent_find(x.begin(), x.end()) != x.end();
+}
+
+
+//! computes the power sums of a vector.
+//! @param x the input vector.
+//! @param k the maximal power.
+//! @return a vector containing \f$ \sum_i x_i^j \f$ for \f$ j = 0, \dots, k\f$.
+inline std::vector<double> power_sums(const std::vector<double>& x, size_t k)
+{
+    std::vector<double> sums(k + 1, 0.0);
+    sums[0] = static_cast<double>(x.size());
+    for (size_t i = 0; i < x.size(); i++) {
+        double xk = 1.0;
+        for (size_t j = 1; j <= k; j++) {
+            xk *= x[i];
+            sums[j] += xk;
+        }
+    }
+
+    return sums;
+}
+
+//! computes the power sums of a vector of ones, see `power_sums()`.
+//! @param n the length of the vector.
+//! @param k the maximal power.
+inline std::vector<double> unit_power_sums(size_t n, size_t k)
+{
+    return std::vector<double>(k + 1, static_cast<double>(n));
+}
+
+//! weight policy for kernels with weights.
+//!
+//! Kernels templated on a weight policy read the weight of observation `i`
+//! as `W::get(weights, i)` and guard all other work on weights by
+//! `W::weighted`, a compile-time constant.
+struct Weighted {
+    static const bool weighted = true;
+    static double get(const double* weights, size_t i) { return weights[i]; }
+};
+
+//! weight policy for kernels without weights; instantiations carry no weight
+//! streams and no per-element branches on the presence of weights.
+struct Unweighted {
+    static const bool weighted = false;
+    static double get(const double*, size_t) { return 1.0; }
+};
 
 //! computes the sum of the products of all k-permutations of elements in a
 //! vector using Newton's identities.
-//! @param x the inpute vector.
+//! @param sums the power sums of the vector (see `power_sums()`) up to at
+//!   least order `k`.
 //! @param k the order of the permutation.
-inline double perm_sum(const std::vector<double>& x, size_t k)
+inline double perm_sum_from_power_sums(const std::vector<double>& sums,
+                                       size_t k)
 {
     if (k == 0)
         return 1.0;
     double s = 0;
     for (size_t i = 1; i <= k; i++)
-        s += std::pow(-1.0, i - 1) * perm_sum(x, k - i) * sum(pow(x, i));
+        s += std::pow(-1.0, i - 1) * perm_sum_from_power_sums(sums, k - i) * sums[i];
     return s / k;
 }
 
+//! computes the sum of the products of all k-permutations of elements in a
+//! vector using Newton's identities.
+//! @param x the inpute vector.
+//! @param k the order of the permutation.
+inline double perm_sum(const std::vector<double>& x, size_t k)
+{
+    return perm_sum_from_power_sums(power_sums(x, k), k);
+}
+
 //! computes the effective sample size from a sequence of weights.
 //! @param n the actual sample size.
 //! @param weights the weight sequence.
@@ -105,6 +183,47 @@ inline double effective_sample_size(size_t n, const std::vector<double>& weights
     return n_eff;
 }
 
+//! adjusts p-values for multiple testing.
+//! @param p the p-values; `nan`s are left untouched and do not count towards
+//!   the number of tests.
+//! @param method `"none"`, `"holm"` (family-wise error rate), or `"BH"`
+//!   (Benjamini-Hochberg, false discovery rate; alias `"fdr"`).
+inline std::vector<double> p_adjust(std::vector<double> p, std::string method)
+{
+    if (method == "none")
+        return p;
+    bool holm = (method == "holm");
+    if (!holm && (method != "BH") && (method != "fdr"))
+        throw std::runtime_error("p_adjust must be one of 'none', 'holm', 'BH'.");
+
+    std::vector<size_t> order;
+    for (size_t i = 0; i < p.size(); i++) {
+        if (!std::isnan(p[i]))
+            order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(),
+              [&] (size_t i, size_t j) { return p[i] < p[j]; });
+
+    size_t m = order.size();
+    if (holm) {
+        // step-down: running maximum of (m - k) p_(k)
+        double p_max = 0.0;
+        for (size_t k = 0; k < m; k++) {
+            p_max = std::max(p_max, (m - k) * p[order[k]]);
+            p[order[k]] = std::min(1.0, p_max);
+        }
+    } else {
+        // step-up: running minimum of m / (k + 1) p_(k)
+        double p_min = 1.0;
+        for (size_t k = m; k-- > 0;) {
+            p_min = std::min(p_min, m * p[order[k]] / (k + 1));
+            p[order[k]] = p_min;
+        }
+    }
+
+    return p;
+}
+
 //! inverts a permutation.
 //! @param perm a permutation.
 //! @return a vector containing the inverse permutation.
@@ -123,6 +242,8 @@ inline std::vector<size_t> get_order(const std::vector<double>& x,
                                      bool ascending = true)
 {
     size_t n = x.size();
+    WDM_PROFILE_SCOPE("sort", n);
+    WDM_PROFILE_ALLOC(n * sizeof(size_t));
     std::vector<size_t> perm(n);
     for (size_t i = 0; i < n; i++)
         perm[i] = i;
@@ -137,13 +258,15 @@ inline std::vector<size_t> get_order(const std::vector<double>& x,
     return perm;
 }
 
-//! sorts x, y, and weights in x order; break ties in according to y.
-//! @param x, y, weights input vectors.
-inline void sort_all(std::vector<double>& x,
-                     std::vector<double>& y,
-                     std::vector<double>& weights)
+//! computes the permutation that brings a vector into ascending order,
+//! breaking ties according to a second vector.
+//! @param x, y input vectors.
+inline std::vector<size_t> get_joint_order(const std::vector<double>& x,
+                                           const std::vector<double>& y)
 {
     size_t n = x.size();
+    WDM_PROFILE_SCOPE("sort", n);
+    WDM_PROFILE_ALLOC(n * sizeof(size_t));
     std::vector<size_t> order(n);
     for (size_t i = 0; i < n; i++)
         order[i] = i;
@@ -152,39 +275,53 @@ inline void sort_all(std::vector<double>& x,
     };
     std::sort(order.begin(), order.end(), sorter_with_tie_break);
 
-    std::vector<double> xx(n), yy(n);
-    for (size_t i = 0; i < n; i++) {
-        xx[i] = x[order[i]];
-        yy[i] = y[order[i]];
-    }
+    return order;
+}
 
-    // sort weights accordingly
-    std::vector<double> w = weights;
-    if (weights.size() > 0) {
-        for (size_t i = 0; i < n; i++) {
-            w[i] = weights[order[i]];
-        }
-    }
+//! rearranges a vector according to a permutation.
+//! @param x input vector; may be empty.
+//! @param perm a permutation.
+//! @return the vector with elements `x[perm[0]], x[perm[1]], ...`.
+inline std::vector<double> permute(const std::vector<double>& x,
+                                   const std::vector<size_t>& perm)
+{
+    if (x.size() == 0)
+        return x;
+    WDM_PROFILE_ALLOC(perm.size() * sizeof(double));
+    std::vector<double> xx(perm.size());
+    for (size_t i = 0; i < perm.size(); i++)
+        xx[i] = x[perm[i]];
+    return xx;
+}
 
-    x = xx;
-    y = yy;
-    weights = w;
+//! sorts x, y, and weights in x order; break ties in according to y.
+//! @param x, y, weights input vectors.
+inline void sort_all(std::vector<double>& x,
+                     std::vector<double>& y,
+                     std::vector<double>& weights)
+{
+    std::vector<size_t> order = get_joint_order(x, y);
+    x = permute(x, order);
+    y = permute(y, order);
+    weights = permute(weights, order);
 }
 
 //! count tied elements according to v_t and v_u in
 //! https://en.wikipedia.org/wiki/Kendall_rank_correlation_coefficient#Significance_tests
+//! @tparam W the weight policy (see `Weighted`).
 //! @param x a sorted input vector.
-//! @param weights optionally, a vector of weights for the elements in `x`.
+//! @param weights pointer to the weights for the elements in `x`; only read
+//!   if `W` is `Weighted`.
 //! @return the number of (weighted) tied element in `x`
-inline double count_ties_v(const std::vector<double>& x,
-                           const std::vector<double>& weights)
+template<class W>
+double count_ties_v(const std::vector<double>& x, const double* weights)
 {
-    bool weighted = (weights.size() > 0);
+    WDM_PROFILE_SCOPE("ties", x.size());
     double count = 0.0, w1 = 0.0, w2 = 0.0;
     size_t reps = 1;
     for (size_t i = 1; i < x.size(); i++) {
         if ((x[i] == x[i - 1])) {
-            if (weighted) {
+            if (W::weighted) {
                 if (reps == 1) {
                     w1 = weights[i - 1];
                     w2 = w1 * w1;
@@ -194,7 +331,7 @@ inline double count_ties_v(const std::vector<double>& x,
             }
             reps++;
         } else if (reps > 1) {
-            if (weighted) {
+            if (W::weighted) {
                 count += (w1 * w1 - w2) * (2 * w1 + 5);
             } else {
                 count += reps * (reps - 1)* (2 * reps + 5);
@@ -204,7 +341,7 @@ inline double count_ties_v(const std::vector<double>& x,
     }
 
     if (reps > 1) {
-        if (weighted) {
+        if (W::weighted) {
             count += (w1 * w1 - w2) * (2 * w1 + 5);
         } else {
             count += reps * (reps - 1) * (2 * reps + 5);
@@ -214,20 +351,32 @@ inline double count_ties_v(const std::vector<double>& x,
     return count;
 }
 
+//! count tied elements according to v_t and v_u, see above.
+//! @param x a sorted input vector.
+//! @param weights optionally, a vector of weights for the elements in `x`.
+inline double count_ties_v(const std::vector<double>& x,
+                           const std::vector<double>& weights)
+{
+    if (weights.size() > 0)
+        return count_ties_v<Weighted>(x, weights.data());
+    return count_ties_v<Unweighted>(x, nullptr);
+}
 
 //! count tied pairs.
+//! @tparam W the weight policy (see `Weighted`).
 //! @param x a sorted input vector.
-//! @param weights optionally, a vector of weights for the elements in `x`.
+//! @param weights pointer to the weights for the elements in `x`; only read
+//!   if `W` is `Weighted`.
 //! @return the number of (weighted) tied pairs in `x`
-inline double count_tied_pairs(const std::vector<double>& x,
-                               const std::vector<double>& weights)
+template<class W>
+double count_tied_pairs(const std::vector<double>& x, const double* weights)
 {
-    bool weighted = (weights.size() > 0);
+    WDM_PROFILE_SCOPE("ties", x.size());
     double count = 0.0, w1 = 0.0, w2 = 0.0;
     size_t reps = 1;
     for (size_t i = 1; i < x.size(); i++) {
         if ((x[i] == x[i - 1])) {
-            if (weighted) {
+            if (W::weighted) {
                 if (reps == 1) {
                     w1 = weights[i - 1];
                     w2 = w1 * w1;
@@ -237,7 +386,7 @@ inline double count_tied_pairs(const std::vector<double>& x,
             }
             reps++;
         } else if (reps > 1) {
-            if (weighted) {
+            if (W::weighted) {
                 count += (w1 * w1 - w2) / 2.0;
             } else {
                 count += reps * (reps - 1) / 2.0;
@@ -247,7 +396,7 @@ inline double count_tied_pairs(const std::vector<double>& x,
     }
 
     if (reps > 1) {
-        if (weighted) {
+        if (W::weighted) {
             count += (w1 * w1 - w2) / 2.0;
         } else {
             count += reps * (reps - 1) / 2.0;
@@ -257,20 +406,32 @@ inline double count_tied_pairs(const std::vector<double>& x,
     return count;
 }
 
-//! count tied triplets.
+//! count tied pairs.
 //! @param x a sorted input vector.
 //! @param weights optionally, a vector of weights for the elements in `x`.
-//! @param break_by second vector that was used to break ties (optional).
+inline double count_tied_pairs(const std::vector<double>& x,
+                               const std::vector<double>& weights)
+{
+    if (weights.size() > 0)
+        return count_tied_pairs<Weighted>(x, weights.data());
+    return count_tied_pairs<Unweighted>(x, nullptr);
+}
+
+//! count tied triplets.
+//! @tparam W the weight policy (see `Weighted`).
+//! @param x a sorted input vector.
+//! @param weights pointer to the weights for the elements in `x`; only read
+//!   if `W` is `Weighted`.
 //! @return the number of (weighted) tied triplets in `x`
-inline double count_tied_triplets(const std::vector<double>& x,
-                                  const std::vector<double>& weights)
+template<class W>
+double count_tied_triplets(const std::vector<double>& x, const double* weights)
 {
-    bool weighted = (weights.size() > 0);
+    WDM_PROFILE_SCOPE("ties", x.size());
     double count = 0.0, w1 = 0.0, w2 = 0.0, w3 = 0.0;
-    size_t reps = 2;
-    for (size_t i = 2; i < x.size(); i++) {
-        if ((x[i] == x[i - 1]) && (x[i] == x[i - 2])) {
-            if (weighted) {
+    size_t reps = 1;
+    for (size_t i = 1; i < x.size(); i++) {
+        if ((x[i] == x[i - 1])) {
+            if (W::weighted) {
                 if (reps == 1) {
                     w1 = weights[i - 1];
                     w2 = std::pow(weights[i - 1], 2);
@@ -281,18 +442,20 @@ inline double count_tied_triplets(const std::vector<double>& x,
                 w3 += std::pow(weights[i], 3);
             }
             reps++;
-        } else if (reps > 2) {
-            if (weighted) {
-                count += (std::pow(w1, 3) - 3 * w2 * w1 + 2 * w3) / 6.0;
-            } else {
-                count += reps * (reps - 1) *  (reps - 2) / 6.0;
+        } else if (reps > 1) {
+            if (reps > 2) {
+                if (W::weighted) {
+                    count += (std::pow(w1, 3) - 3 * w2 * w1 + 2 * w3) / 6.0;
+                } else {
+                    count += reps * (reps - 1) *  (reps - 2) / 6.0;
+                }
             }
             reps = 1;
         }
     }
 
     if (reps > 2) {
-        if (weighted) {
+        if (W::weighted) {
             count += (std::pow(w1, 3) - 3 * w2 * w1 + 2 * w3) / 6.0;
         } else {
             count += reps * (reps - 1) * (reps - 2) / 6.0;
@@ -302,21 +465,35 @@ inline double count_tied_triplets(const std::vector<double>& x,
     return count;
 }
 
+//! count tied triplets.
+//! @param x a sorted input vector.
+//! @param weights optionally, a vector of weights for the elements in `x`.
+inline double count_tied_triplets(const std::vector<double>& x,
+                                  const std::vector<double>& weights)
+{
+    if (weights.size() > 0)
+        return count_tied_triplets<Weighted>(x, weights.data());
+    return count_tied_triplets<Unweighted>(x, nullptr);
+}
+
 //! counts joint ties in two vectors.
+//! @tparam W the weight policy (see `Weighted`).
 //! @param x, y a input vectors that are sorted wrt `x` as first and `y` as
 //!   secondary key.
-//! @param weights optionally, a vector of weights for the elements in `x`.
+//! @param weights pointer to the weights for the elements in `x`; only read
+//!   if `W` is `Weighted`.
 //! @return the number of (weighted) joint ties in `x` and `y`.
-inline double count_joint_ties(const std::vector<double>& x,
-                               const std::vector<double>& y,
-                               const std::vector<double>& weights)
+template<class W>
+double count_joint_ties(const std::vector<double>& x,
+                        const std::vector<double>& y,
+                        const double* weights)
 {
-    bool weighted = (weights.size() > 0);
+    WDM_PROFILE_SCOPE("ties", x.size());
     double count = 0.0, w1 = 0.0, w2 = 0.0;
     size_t reps = 1;
     for (size_t i = 1; i < x.size(); i++) {
         if ((x[i] == x[i - 1]) && (y[i] == y[i - 1])) {
-            if (weighted) {
+            if (W::weighted) {
                 if (reps == 1) {
                     w1 = weights[i - 1];
                     w2 = weights[i - 1] * weights[i - 1];
@@ -326,7 +503,7 @@ inline double count_joint_ties(const std::vector<double>& x,
             }
             reps++;
         } else if (reps > 1) {
-            if (weighted) {
+            if (W::weighted) {
                 count += (w1 * w1 - w2) / 2.0;
             } else {
                 count += reps * (reps - 1) / 2.0;
@@ -336,7 +513,7 @@ inline double count_joint_ties(const std::vector<double>& x,
     }
 
     if (reps > 1) {
-        if (weighted) {
+        if (W::weighted) {
             count += (w1 * w1 - w2) / 2.0;
         } else {
             count += reps * (reps - 1) / 2.0;
@@ -346,25 +523,117 @@ inline double count_joint_ties(const std::vector<double>& x,
     return count;
 }
 
+//! counts joint ties in two vectors.
+//! @param x, y a input vectors that are sorted wrt `x` as first and `y` as
+//!   secondary key.
+//! @param weights optionally, a vector of weights for the elements in `x`.
+inline double count_joint_ties(const std::vector<double>& x,
+                               const std::vector<double>& y,
+                               const std::vector<double>& weights)
+{
+    if (weights.size() > 0)
+        return count_joint_ties<Weighted>(x, y, weights.data());
+    return count_joint_ties<Unweighted>(x, y, nullptr);
+}
+
+//! counts tied pairs exactly (unweighted).
+//! @param x a sorted input vector.
+//! @return the number of tied pairs in `x`.
+inline uint64_t count_tied_pairs_exact(const std::vector<double>& x)
+{
+    WDM_PROFILE_SCOPE("ties", x.size());
+    uint64_t count = 0, reps = 1;
+    for (size_t i = 1; i < x.size(); i++) {
+        if (x[i] == x[i - 1]) {
+            reps++;
+        } else {
+            count += reps * (reps - 1) / 2;
+            reps = 1;
+        }
+    }
+
+    return count + reps * (reps - 1) / 2;
+}
+
+//! counts joint ties in two vectors exactly (unweighted).
+//! @param x, y input vectors that are sorted wrt `x` as first and `y` as
+//!   secondary key.
+//! @return the number of joint ties in `x` and `y`.
+inline uint64_t count_joint_ties_exact(const std::vector<double>& x,
+                                       const std::vector<double>& y)
+{
+    WDM_PROFILE_SCOPE("ties", x.size());
+    uint64_t count = 0, reps = 1;
+    for (size_t i = 1; i < x.size(); i++) {
+        if ((x[i] == x[i - 1]) && (y[i] == y[i - 1])) {
+            reps++;
+        } else {
+            count += reps * (reps - 1) / 2;
+            reps = 1;
+        }
+    }
+
+    return count + reps * (reps - 1) / 2;
+}
+
+//! sorts a vector while counting inversions exactly (unweighted).
+//!
+//! A bottom-up merge sort with a single buffer; runs that are already in
+//! order are copied without comparisons.
+//!
+//! @param vec the vector to be sorted.
+//! @return the number of pairs \f$ i < j \f$ with `vec[i] > vec[j]`.
+inline uint64_t count_inversions(std::vector<double>& vec)
+{
+    size_t n = vec.size();
+    WDM_PROFILE_ALLOC(n * sizeof(double));
+    std::vector<double> buf(n);
+    uint64_t count = 0;
+    for (size_t width = 1; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            size_t mid = std::min(lo + width, n), hi = std::min(mid + width, n);
+            size_t i = lo, j = mid, k = lo;
+            if ((mid < hi) && (vec[mid - 1] > vec[mid])) {
+                while ((i < mid) && (j < hi)) {
+                    if (vec[i] <= vec[j]) {
+                        buf[k++] = vec[i++];
+                    } else {
+                        buf[k++] = vec[j++];
+                        count += mid - i;
+                    }
+                }
+            }
+            std::copy(vec.begin() + i, vec.begin() + mid, buf.begin() + k);
+            std::copy(vec.begin() + j, vec.begin() + hi,
+                      buf.begin() + k + (mid - i));
+        }
+        vec.swap(buf);
+    }
+
+    return count;
+}
+
 //! merge sort for a pair of vectors, counting inversions.
+//! @tparam W the weight policy (see `Weighted`); weight vectors are neither
+//!   read nor written if `W` is `Unweighted`.
 //! @param vec container for the sorted elements.
 //! @param vec1, vec2 sorted input vectors to be merged.
 //! @param weights container for the weights corresponding to sorted elements
-//!   in `vec`; can be empty for unweighted counts.
+//!   in `vec`.
 //! @param weights1, weights2 weights corresponding to input vectors `vec1`,
-//!   `vec2`; can be empty for unweighted counts.
+//!   `vec2`.
 //! @param count counter to which the (weighted) number of inversions is added.
-inline void merge(std::vector<double>& vec,
-                  const std::vector<double>& vec1,
-                  const std::vector<double>& vec2,
-                  std::vector<double>& weights,
-                  const std::vector<double>& weights1,
-                  const std::vector<double>& weights2,
-                  double& count)
+template<class W>
+void merge(std::vector<double>& vec,
+           const std::vector<double>& vec1,
+           const std::vector<double>& vec2,
+           std::vector<double>& weights,
+           const std::vector<double>& weights1,
+           const std::vector<double>& weights2,
+           double& count)
 {
     double w_acc = 0.0, w1_sum = 0.0;
-    bool weighted = (weights.size() > 0);
-    if (weighted) {
+    if (W::weighted) {
         for (size_t i = 0; i < weights1.size(); i++)
             w1_sum += weights1[i];
     }
@@ -372,14 +641,14 @@ inline void merge(std::vector<double>& vec,
     for (i = 0, j = 0, k = 0; i < vec1.size() && j < vec2.size(); k++) {
         if (vec1[i] <= vec2[j]) {
             vec[k] = vec1[i];
-            if (weighted) {
+            if (W::weighted) {
                 weights[k] = weights1[i];
                 w_acc += weights1[i];
             }
             i++;
         } else {
             vec[k] = vec2[j];
-            if (weighted) {
+            if (W::weighted) {
                 weights[k] = weights2[j];
                 count += weights2[j] * (w1_sum - w_acc);
             } else {
@@ -391,7 +660,7 @@ inline void merge(std::vector<double>& vec,
 
     while (i < vec1.size()) {
         vec[k] = vec1[i];
-        if (weighted)
+        if (W::weighted)
             weights[k] = weights1[i];
         k++;
         i++;
@@ -399,62 +668,108 @@ inline void merge(std::vector<double>& vec,
 
     while (j < vec2.size()) {
         vec[k] = vec2[j];
-        if (weighted)
+        if (W::weighted)
             weights[k] = weights2[j];
         k++;
         j++;
     }
 }
 
+//! merge sort for a pair of vectors, counting inversions; see above.
+//! @param vec container for the sorted elements.
+//! @param vec1, vec2 sorted input vectors to be merged.
+//! @param weights container for the weights corresponding to sorted elements
+//!   in `vec`; can be empty for unweighted counts.
+//! @param weights1, weights2 weights corresponding to input vectors `vec1`,
+//!   `vec2`; can be empty for unweighted counts.
+//! @param count counter to which the (weighted) number of inversions is added.
+inline void merge(std::vector<double>& vec,
+                  const std::vector<double>& vec1,
+                  const std::vector<double>& vec2,
+                  std::vector<double>& weights,
+                  const std::vector<double>& weights1,
+                  const std::vector<double>& weights2,
+                  double& count)
+{
+    if (weights.size() > 0) {
+        merge<Weighted>(vec, vec1, vec2, weights, weights1, weights2, count);
+    } else {
+        merge<Unweighted>(vec, vec1, vec2, weights, weights1, weights2, count);
+    }
+}
+
 //! sorting elements in a vector while counting inversions.
+//! @tparam W the weight policy (see `Weighted`).
 //! @param vec the vector to be sorted.
-//! @param weights vector of weights corresponding to `vec`; can be empty for
-//!   unweighted counts.
+//! @param weights vector of weights corresponding to `vec`; ignored if `W`
+//!   is `Unweighted`.
 //! @param count counter to which the (weighted) number of inversions are added.
-inline void merge_sort(std::vector<double>& vec,
-                       std::vector<double>& weights,
-                       double& count)
+template<class W>
+void merge_sort(std::vector<double>& vec,
+                std::vector<double>& weights,
+                double& count)
 {
     if (vec.size() > 1) {
         size_t n = vec.size();
+        WDM_PROFILE_ALLOC((W::weighted ? 2 : 1) * n * sizeof(double));
         std::vector<double> vec1(vec.begin(), vec.begin() + n / 2);
         std::vector<double> vec2(vec.begin() + n / 2, vec.end());
 
-        n = weights.size();
-        std::vector<double> weights1(weights.begin(), weights.begin() + n / 2);
-        std::vector<double> weights2(weights.begin() + n / 2, weights.end());
+        std::vector<double> weights1, weights2;
+        if (W::weighted) {
+            weights1.assign(weights.begin(), weights.begin() + n / 2);
+            weights2.assign(weights.begin() + n / 2, weights.end());
+        }
 
-        merge_sort(vec1, weights1, count);
-        merge_sort(vec2, weights2, count);
-        merge(vec, vec1, vec2, weights, weights1, weights2, count);
+        merge_sort<W>(vec1, weights1, count);
+        merge_sort<W>(vec2, weights2, count);
+        merge<W>(vec, vec1, vec2, weights, weights1, weights2, count);
+    }
+}
+
+//! sorting elements in a vector while counting inversions.
+//! @param vec the vector to be sorted.
+//! @param weights vector of weights corresponding to `vec`; can be empty for
+//!   unweighted counts.
+//! @param count counter to which the (weighted) number of inversions are added.
+inline void merge_sort(std::vector<double>& vec,
+                       std::vector<double>& weights,
+                       double& count)
+{
+    if (weights.size() > 0) {
+        merge_sort<Weighted>(vec, weights, count);
+    } else {
+        merge_sort<Unweighted>(vec, weights, count);
     }
 }
 
 //! merge operation for a pair of vectors, counting inversions per element.
+//! @tparam W the weight policy (see `Weighted`); weight vectors are neither
+//!   read nor written if `W` is `Unweighted`.
 //! @param vec container for the sorted elements.
 //! @param vec1, vec2 sorted input vectors to be merged.
 //! @param weights container for the weights corresponding to sorted elements
-//!   in `vec`; can be empty for unweighted counts.
+//!   in `vec`.
 //! @param weights1, weights2 weights corresponding to input vectors`vec1`,
-//!   `vec2`; can be empty for unweighted counts.
+//!   `vec2`.
 //! @param counts container for the counts corresponding to sorted elements
 //!   in `vec`.
 //! @param counts1, counts2 counts corresponding to input vectors`vec1`,
 //!   `vec2` to which (weighted) counts are added.
-inline void merge_count_per_element(std::vector<double>& vec,
-                                    const std::vector<double>& vec1,
-                                    const std::vector<double>& vec2,
-                                    std::vector<double>& weights,
-                                    const std::vector<double>& weights1,
-                                    const std::vector<double>& weights2,
-                                    std::vector<double>& counts,
-                                    const std::vector<double>& counts1,
-                                    const std::vector<double>& counts2)
+template<class W>
+void merge_count_per_element(std::vector<double>& vec,
+                             const std::vector<double>& vec1,
+                             const std::vector<double>& vec2,
+                             std::vector<double>& weights,
+                             const std::vector<double>& weights1,
+                             const std::vector<double>& weights2,
+                             std::vector<double>& counts,
+                             const std::vector<double>& counts1,
+                             const std::vector<double>& counts2)
 {
     double w_acc = 0.0;
-    bool weighted = (weights.size() > 0);
     double w1_sum = 0.0;
-    if (weighted) {
+    if (W::weighted) {
         for (size_t i = 0; i < weights1.size(); i++)
             w1_sum += weights1[i];
     }
@@ -463,14 +778,14 @@ inline void merge_count_per_element(std::vector<double>& vec,
         if (vec1[i] > vec2[j]) {
             vec[k] = vec1[i];
             counts[k] = counts1[i];
-            if (weighted) {
+            if (W::weighted) {
                 weights[k] = weights1[i];
                 w_acc += weights1[i];
             }
             i++;
         } else {
             vec[k] = vec2[j];
-            if (weighted) {
+            if (W::weighted) {
                 counts[k] = counts2[j] + w1_sum - w_acc;
                 weights[k] = weights2[j];
             } else {
@@ -482,7 +797,7 @@ inline void merge_count_per_element(std::vector<double>& vec,
 
     while (i < vec1.size()) {
         vec[k] = vec1[i];
-        if (weighted)
+        if (W::weighted)
             weights[k] = weights1[i];
         counts[k] = counts1[i];
         k++;
@@ -491,7 +806,7 @@ inline void merge_count_per_element(std::vector<double>& vec,
 
     while (j < vec2.size()) {
         vec[k] = vec2[j];
-        if (weighted)
+        if (W::weighted)
             weights[k] = weights2[j];
         counts[k] = counts2[j];
         k++;
@@ -499,38 +814,158 @@ inline void merge_count_per_element(std::vector<double>& vec,
     }
 }
 
+//! merge operation for a pair of vectors, counting inversions per element;
+//! see above.
+//! @param vec container for the sorted elements.
+//! @param vec1, vec2 sorted input vectors to be merged.
+//! @param weights container for the weights corresponding to sorted elements
+//!   in `vec`; can be empty for unweighted counts.
+//! @param weights1, weights2 weights corresponding to input vectors`vec1`,
+//!   `vec2`; can be empty for unweighted counts.
+//! @param counts container for the counts corresponding to sorted elements
+//!   in `vec`.
+//! @param counts1, counts2 counts corresponding to input vectors`vec1`,
+//!   `vec2` to which (weighted) counts are added.
+inline void merge_count_per_element(std::vector<double>& vec,
+                                    const std::vector<double>& vec1,
+                                    const std::vector<double>& vec2,
+                                    std::vector<double>& weights,
+                                    const std::vector<double>& weights1,
+                                    const std::vector<double>& weights2,
+                                    std::vector<double>& counts,
+                                    const std::vector<double>& counts1,
+                                    const std::vector<double>& counts2)
+{
+    if (weights.size() > 0) {
+        merge_count_per_element<Weighted>(vec, vec1, vec2,
+                                          weights, weights1, weights2,
+                                          counts, counts1, counts2);
+    } else {
+        merge_count_per_element<Unweighted>(vec, vec1, vec2,
+                                            weights, weights1, weights2,
+                                            counts, counts1, counts2);
+    }
+}
 
 //! sorts elements in a vector while counting inversions per element.
+//! @tparam W the weight policy (see `Weighted`).
 //! @param vec the vector to be sorted.
+//! @param weights vector of weights corresponding to `vec`; ignored if `W`
+//!   is `Unweighted`.
 //! @param counts vector of counters to which the (weighted) number of inversions
 //!   (per element) are added.
-//! @param weights vector of weights corresponding to `vec`; can be empty for
-//!   unweighted counts.
-inline void merge_sort_count_per_element(std::vector<double>& vec,
-                                         std::vector<double>& weights,
-                                         std::vector<double>& counts)
+template<class W>
+void merge_sort_count_per_element(std::vector<double>& vec,
+                                  std::vector<double>& weights,
+                                  std::vector<double>& counts)
 {
     if (vec.size() > 1) {
         size_t n = vec.size();
+        WDM_PROFILE_ALLOC((W::weighted ? 3 : 2) * n * sizeof(double));
         std::vector<double> vec1(vec.begin(), vec.begin() + n / 2);
         std::vector<double> vec2(vec.begin() + n / 2, vec.end());
 
-        n = weights.size();
-        std::vector<double> weights1(weights.begin(), weights.begin() + n / 2);
-        std::vector<double> weights2(weights.begin() + n / 2, weights.end());
+        std::vector<double> weights1, weights2;
+        if (W::weighted) {
+            weights1.assign(weights.begin(), weights.begin() + n / 2);
+            weights2.assign(weights.begin() + n / 2, weights.end());
+        }
 
-        n = counts.size();
         std::vector<double> counts1(counts.begin(), counts.begin() + n / 2);
         std::vector<double> counts2(counts.begin() + n / 2, counts.end());
 
-        merge_sort_count_per_element(vec1, weights1, counts1);
-        merge_sort_count_per_element(vec2, weights2, counts2);
-        merge_count_per_element(vec, vec1, vec2,
-                                weights, weights1, weights2,
-                                counts, counts1, counts2);
+        merge_sort_count_per_element<W>(vec1, weights1, counts1);
+        merge_sort_count_per_element<W>(vec2, weights2, counts2);
+        merge_count_per_element<W>(vec, vec1, vec2,
+                                   weights, weights1, weights2,
+                                   counts, counts1, counts2);
     }
 }
 
+//! sorts elements in a vector while counting inversions per element.
+//! @param vec the vector to be sorted.
+//! @param counts vector of counters to which the (weighted) number of inversions
+//!   (per element) are added.
+//! @param weights vector of weights corresponding to `vec`; can be empty for
+//!   unweighted counts.
+inline void merge_sort_count_per_element(std::vector<double>& vec,
+                                         std::vector<double>& weights,
+                                         std::vector<double>& counts)
+{
+    if (weights.size() > 0) {
+        merge_sort_count_per_element<Weighted>(vec, weights, counts);
+    } else {
+        merge_sort_count_per_element<Unweighted>(vec, weights, counts);
+    }
+}
+
+//! a Fenwick (binary indexed) tree holding several lanes of cumulative sums.
+//!
+//! Each node stores `lanes` sums contiguously, so that updates and queries
+//! for all lanes share the index computations.
+class Fenwick_tree {
+public:
+    //! @param size the number of positions (positions are `1, ..., size`).
+    //! @param lanes the number of lanes.
+    Fenwick_tree(size_t size, size_t lanes) :
+        size_(size),
+        lanes_(lanes),
+        tree_((size + 1) * lanes, 0.0)
+    {
+        WDM_PROFILE_ALLOC(tree_.size() * sizeof(double));
+    }
+
+    //! adds values to a position.
+    //! @param pos the position (starting at 1).
+    //! @param values pointer to `lanes` values.
+    void add(size_t pos, const double* values)
+    {
+        for (; pos <= size_; pos += pos & (~pos + 1)) {
+            double* node = &tree_[pos * lanes_];
+            for (size_t l = 0; l < lanes_; l++)
+                node[l] += values[l];
+        }
+    }
+
+    //! computes the sums over all positions up to (and including) `pos`.
+    //! @param pos the position (starting at 1); 0 gives zero sums.
+    //! @param sums pointer to `lanes` values where the results are stored.
+    void prefix_sum(size_t pos, double* sums) const
+    {
+        for (size_t l = 0; l < lanes_; l++)
+            sums[l] = 0.0;
+        for (; pos > 0; pos -= pos & (~pos + 1)) {
+            const double* node = &tree_[pos * lanes_];
+            for (size_t l = 0; l < lanes_; l++)
+                sums[l] += node[l];
+        }
+    }
+
+private:
+    size_t size_;
+    size_t lanes_;
+    std::vector<double> tree_;
+};
+
+//! computes dense ranks (starting at 1) from a known ordering of the data.
+//! @param x input vector.
+//! @param perm a permutation that brings `x` in ascending order.
+//! @return a vector containing the ranks of each element in `x`; tied
+//!   elements share the same rank and ranks have no gaps.
+inline std::vector<size_t> dense_ranks(const std::vector<double>& x,
+                                       const std::vector<size_t>& perm)
+{
+    std::vector<size_t> ranks(x.size());
+    size_t r = 0;
+    for (size_t k = 0; k < perm.size(); k++) {
+        if ((k == 0) || (x[perm[k]] != x[perm[k - 1]]))
+            r++;
+        ranks[perm[k]] = r;
+    }
+
+    return ranks;
+}
+
 } /// end utils
 
 } // end wdm
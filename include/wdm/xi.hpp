@@ -0,0 +1,162 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+#include "utils.hpp"
+#include "ranks.hpp"
+#include <cmath>
+
+namespace wdm {
+
+namespace impl {
+
+//! computes a permutation bringing `x` in ascending order, where ties are
+//! broken at random as in `rank()` with `ties_method = "random"`.
+//! @param x input data (without missing values).
+//! @param key key of the random number generator (see `random::make_key()`).
+inline std::vector<size_t> xi_order(const std::vector<double>& x, uint64_t key)
+{
+    size_t n = x.size();
+    std::vector<double> ranks(n);
+    Rank_workspace ws;
+    rank_into(x.data(), n, nullptr, "random", key, ranks.data(), ws);
+
+    // unweighted ranks with random ties are the integers 1, ..., n
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++)
+        order[static_cast<size_t>(ranks[i]) - 1] = i;
+
+    return order;
+}
+
+//! quantities of the response variable entering Chatterjee's xi.
+struct Xi_response {
+    std::vector<double> r;  //!< weighted proportion of observations at most as large.
+    double denominator;     //!< weighted sum of \f$ L_i (1 - L_i) \f$.
+    double tau;             //!< standard deviation of the asymptotic null distribution.
+};
+
+//! computes the quantities of the response variable entering Chatterjee's xi.
+//! @param y input data (without missing values).
+//! @param weights vector of weights for the data; can be empty.
+//! @details
+//! With \f$ R_i \f$ and \f$ L_i \f$ the weighted proportions of observations
+//! at most and at least as large as \f$ y_i \f$, the asymptotic standard
+//! deviation is estimated as in Theorem 2.2 of Chatterjee (2021); with
+//! weights, the averages over observations become weighted averages.
+inline Xi_response xi_response(const std::vector<double>& y,
+                               const std::vector<double>& weights)
+{
+    size_t n = y.size();
+    auto weight = [&weights] (size_t i) {
+        return (weights.size() > 0) ? weights[i] : 1.0;
+    };
+    double w_sum = 0.0;
+    for (size_t i = 0; i < n; i++)
+        w_sum += weight(i);
+
+    Xi_response res;
+    res.r.resize(n);
+    res.denominator = 0.0;
+    auto perm = utils::get_order(y);
+    double w_below = 0.0;
+    for (size_t i = 0, reps; i < n; i += reps) {
+        double w_group = 0.0;
+        for (reps = 0; (i + reps < n) && (y[perm[i + reps]] == y[perm[i]]); reps++)
+            w_group += weight(perm[i + reps]);
+        double l = (w_sum - w_below) / w_sum;
+        for (size_t k = 0; k < reps; k++) {
+            res.r[perm[i + k]] = (w_below + w_group) / w_sum;
+            res.denominator += weight(perm[i + k]) * l * (1 - l);
+        }
+        w_below += w_group;
+    }
+
+    // the r's are non-decreasing along perm
+    double a = 0.0, b = 0.0, c = 0.0, p_cum = 0.0, pr_cum = 0.0;
+    for (size_t k = 0; k < n; k++) {
+        double p = weight(perm[k]) / w_sum, u = res.r[perm[k]];
+        p_cum += p;
+        pr_cum += p * u;
+        double m = pr_cum + (1 - p_cum) * u;
+        a += p * (2 * (1 - p_cum) + p) * u * u;
+        c += p * (2 * (1 - p_cum) + p) * u;
+        b += p * m * m;
+    }
+    double d = res.denominator / w_sum;
+    res.tau = std::sqrt(std::max(a - 2 * b + c * c, 0.0)) / d;
+
+    return res;
+}
+
+//! calculates the (weighted) Chatterjee's xi from the x order and the
+//! quantities of the response.
+//! @param order_x a permutation bringing x in ascending order (see
+//!   `xi_order()`).
+//! @param resp_y the quantities of the response (see `xi_response()`).
+//! @param weights vector of weights for the data; can be empty.
+inline double xi_from_order(const std::vector<size_t>& order_x,
+                            const Xi_response& resp_y,
+                            const std::vector<double>& weights)
+{
+    double num = 0.0;
+    for (size_t k = 1; k < order_x.size(); k++) {
+        size_t i = order_x[k - 1], j = order_x[k];
+        double w = (weights.size() > 0) ? (weights[i] + weights[j]) / 2 : 1.0;
+        num += w * std::abs(resp_y.r[j] - resp_y.r[i]);
+    }
+
+    return 1 - num / (2 * resp_y.denominator);
+}
+
+//! default seeds for breaking ties in x, making the results reproducible.
+inline std::vector<int> xi_default_seeds()
+{
+    return {29, 5, 1987};
+}
+
+//! calculates the (weighted) Chatterjee's xi.
+//! @param x, y input data.
+//! @param weights an optional vector of weights for the data.
+//! @param seeds seeds of the random number generator used to break ties in
+//!   x; by default, fixed seeds make the result reproducible.
+//! @details
+//! The coefficient
+//! \f[ \xi = 1 - \frac{\sum_{k} w_{(k, k + 1)}|R_{(k + 1)} - R_{(k)}|}
+//!                    {2 \sum_i w_i L_i (1 - L_i)} \f]
+//! measures how well y is explained by a (not necessarily monotone) function
+//! of x (Chatterjee, 2021). Here, \f$ (k) \f$ indexes the observations in x
+//! order (ties broken at random), \f$ R_i \f$ and \f$ L_i \f$ are the weighted
+//! proportions of observations with a y at most and at least as large as
+//! \f$ y_i \f$, and consecutive observations get the average of their weights.
+//! With unit weights, this is Chatterjee's original coefficient. The
+//! coefficient is not symmetric in x and y.
+inline double xi(const std::vector<double>& x,
+                 const std::vector<double>& y,
+                 const std::vector<double>& weights = std::vector<double>(),
+                 const std::vector<int>& seeds = xi_default_seeds())
+{
+    WDM_PROFILE_SCOPE("xi", x.size());
+    utils::check_sizes(x, y, weights);
+    return xi_from_order(xi_order(x, random::make_key(seeds)),
+                         xi_response(y, weights),
+                         weights);
+}
+
+//! calculates the adjustment for the test statistic of Chatterjee's xi, the
+//! inverse of the standard deviation of its asymptotic null distribution.
+//! @param y input data of the response.
+//! @param weights an optional vector of weights for the data.
+inline double xi_stat_adjust(const std::vector<double>& y,
+                             const std::vector<double>& weights = std::vector<double>())
+{
+    return 1.0 / xi_response(y, weights).tau;
+}
+
+}
+
+}
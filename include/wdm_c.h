@@ -0,0 +1,162 @@
+/* Copyright © 2020 Thomas Nagler
+ *
+ * This file is part of the wdm library and licensed under the terms of
+ * the MIT license. For a copy, see the LICENSE file in the root directory
+ * or https://github.com/tnagler/wdm/blob/master/LICENSE.
+ */
+
+/*! @file wdm_c.h
+ * C interface of the wdm library.
+ *
+ * The functions below are exported by the optional shared library `wdm_c`
+ * (CMake option `WDM_BUILD_C_LIBRARY`). They take raw pointers to the data
+ * together with strides, so that arrays owned by foreign callers (numpy, R,
+ * Julia, ...) can be passed without converting them first, and write all
+ * results into buffers provided by the caller.
+ *
+ * Contiguous arrays (stride one) are read in place by the kernels that do
+ * not reorder the data: Pearson's correlation, and Kendall's tau and
+ * Spearman's rho of samples without missing values of at most 64
+ * observations (also in `wdm_pair_batch()`). The other measures sort or
+ * rank the data and work on a copy, as does `wdm_indep_test()`; strided
+ * arrays are gathered into a contiguous copy first.
+ *
+ * Strides are counted in elements (not bytes) and may be negative. A `NULL`
+ * weight pointer stands for unit weights. Methods are given by the names
+ * accepted by `wdm::wdm()`, e.g., `"kendall"` or `"spearman"`.
+ *
+ * All functions return a status code; if it is not `WDM_OK`, a description
+ * of the error can be retrieved by `wdm_last_error()`. No function throws or
+ * calls back into the caller, and none of them requires a lock held by the
+ * caller (e.g., Python's GIL), so they may be called concurrently from
+ * several threads.
+ */
+
+#ifndef WDM_C_H
+#define WDM_C_H
+
+#include <stddef.h>
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+#  if defined(WDM_C_BUILDING)
+#    define WDM_C_API __declspec(dllexport)
+#  else
+#    define WDM_C_API __declspec(dllimport)
+#  endif
+#elif defined(__GNUC__) && (__GNUC__ >= 4)
+#  define WDM_C_API __attribute__((visibility("default")))
+#else
+#  define WDM_C_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! status codes returned by all functions. */
+typedef enum {
+    WDM_OK = 0,                     /*!< success */
+    WDM_ERROR_NULL_POINTER = 1,     /*!< a required pointer is `NULL` */
+    WDM_ERROR_INVALID_ARGUMENT = 2, /*!< invalid method, data, or options */
+    WDM_ERROR_OUT_OF_MEMORY = 3,    /*!< memory allocation failed */
+    WDM_ERROR_UNKNOWN = 4           /*!< any other error */
+} wdm_status;
+
+/*! the version of the library, e.g., `"0.2.6"`. */
+WDM_C_API const char* wdm_version(void);
+
+/*! a description of the last error in the calling thread; an empty string if
+ * there was none. The pointer stays valid until the next call into the
+ * library from the same thread. */
+WDM_C_API const char* wdm_last_error(void);
+
+/*! calculates a (weighted) dependence measure for a single pair.
+ * @param x, y pointers to the input data.
+ * @param x_stride, y_stride distance between two consecutive elements.
+ * @param w pointer to the weights or `NULL`.
+ * @param w_stride distance between two consecutive weights.
+ * @param n number of observations.
+ * @param method the dependence measure.
+ * @param remove_missing if non-zero, observations containing a `nan` are
+ *   removed; otherwise an error is returned if `nan`s are present.
+ * @param out pointer to the result. */
+WDM_C_API wdm_status wdm_pair(const double* x, ptrdiff_t x_stride,
+                              const double* y, ptrdiff_t y_stride,
+                              const double* w, ptrdiff_t w_stride,
+                              size_t n,
+                              const char* method,
+                              int remove_missing,
+                              double* out);
+
+/*! calculates a (weighted) independence test for a single pair.
+ * Arguments are as in `wdm_pair()`.
+ * @param alternative `"two-sided"`, `"greater"`, or `"less"`.
+ * @param estimate, statistic, p_value pointers to the results; each of them
+ *   may be `NULL` if the corresponding result is not needed. */
+WDM_C_API wdm_status wdm_indep_test(const double* x, ptrdiff_t x_stride,
+                                    const double* y, ptrdiff_t y_stride,
+                                    const double* w, ptrdiff_t w_stride,
+                                    size_t n,
+                                    const char* method,
+                                    int remove_missing,
+                                    const char* alternative,
+                                    double* estimate,
+                                    double* statistic,
+                                    double* p_value);
+
+/*! calculates a (weighted) dependence measure for many samples stored
+ * contiguously (see `wdm::wdm_batch()`).
+ * @param x, y pointers to the input data.
+ * @param w pointer to the weights or `NULL`.
+ * @param offsets the start of each sample followed by the end of the last
+ *   sample (`num_samples + 1` values); must be non-decreasing.
+ * @param num_samples number of samples.
+ * @param method the dependence measure.
+ * @param remove_missing see `wdm_pair()`.
+ * @param num_threads number of threads; `0` uses all available cores.
+ * @param out pointer to the results (`num_samples` values). */
+WDM_C_API wdm_status wdm_pair_batch(const double* x,
+                                    const double* y,
+                                    const double* w,
+                                    const size_t* offsets,
+                                    size_t num_samples,
+                                    const char* method,
+                                    int remove_missing,
+                                    size_t num_threads,
+                                    double* out);
+
+/*! calculates a (weighted) dependence measure for all pairs of columns of a
+ * matrix.
+ * @param x pointer to the input data; element `(i, j)` is
+ *   `x[i * row_stride + j * col_stride]`, so that both row- and column-major
+ *   arrays (and slices of them) can be passed.
+ * @param n, d number of rows (observations) and columns (variables); an
+ *   error is returned if `d < 2`.
+ * @param row_stride, col_stride distance between two consecutive rows and
+ *   columns.
+ * @param w pointer to the weights for each row (contiguous) or `NULL`.
+ * @param method the dependence measure.
+ * @param remove_missing if non-zero, observations containing a `nan` are
+ *   removed for each pair separately; otherwise an error is returned if
+ *   `nan`s are present.
+ * @param num_threads number of threads; `0` uses all available cores.
+ * @param out pointer to the result, a `d x d` matrix stored contiguously;
+ *   `out[i * d + j]` is the measure with column `i` as first and column `j`
+ *   as second argument, which is symmetric except for Chatterjee's xi. The
+ *   diagonal is set to one. */
+WDM_C_API wdm_status wdm_matrix(const double* x,
+                                size_t n,
+                                size_t d,
+                                ptrdiff_t row_stride,
+                                ptrdiff_t col_stride,
+                                const double* w,
+                                const char* method,
+                                int remove_missing,
+                                size_t num_threads,
+                                double* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#pragma once
+
+/*! @file wdm_lib.hpp
+ * Slim C++ interface of the compiled wdm libraries.
+ *
+ * The functions below are defined in the optional libraries `wdm_static`
+ * and `wdm_shared` (CMake option `WDM_BUILD_LIBRARY`). This header only
+ * declares them and includes nothing but standard headers, so translation
+ * units using it do not parse the implementation (or Eigen). They mirror the
+ * header-only interface in `wdm.hpp`, which remains available and can be
+ * used alongside.
+ */
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace wdm {
+
+namespace lib {
+
+//! calculates a (weighted) dependence measure; see `wdm::wdm()`.
+double wdm(const std::vector<double>& x,
+           const std::vector<double>& y,
+           const std::string& method,
+           const std::vector<double>& weights = std::vector<double>(),
+           bool remove_missing = true);
+
+//! calculates (weighted) dependence measures for many samples stored
+//! contiguously; see `wdm::wdm_batch()`.
+std::vector<double> wdm_batch(const std::vector<double>& x,
+                              const std::vector<double>& y,
+                              const std::vector<size_t>& offsets,
+                              const std::string& method,
+                              const std::vector<double>& weights = std::vector<double>(),
+                              bool remove_missing = true,
+                              size_t num_threads = 0);
+
+//! calculates a matrix of (weighted) dependence measures in parallel.
+//! @param x pointer to the input data (column-major, `n` rows and `d`
+//!    columns).
+//! @param n, d number of rows and columns; throws an error if `d < 2`.
+//! @param method the dependence measure; see `wdm::wdm()`.
+//! @param weights pointer to the weights for each row; `nullptr` stands
+//!    for unit weights.
+//! @param remove_missing if `true`, all observations containing a `nan` are
+//!    removed (separately for each pair); otherwise throws an error if `nan`s
+//!    are present.
+//! @param num_threads number of threads; `0` uses all available cores.
+//! @return the `d x d` matrix in column-major order; the entry `(i, j)` is
+//!    the measure with column `i` as first and column `j` as second
+//!    argument.
+std::vector<double> wdm_matrix(const double* x,
+                               size_t n,
+                               size_t d,
+                               const std::string& method,
+                               const double* weights = nullptr,
+                               bool remove_missing = true,
+                               size_t num_threads = 0);
+
+//! calculates a dependence measure between a time series and the lags of
+//! another; see `wdm::wdm_lags()`.
+std::vector<double> wdm_lags(const std::vector<double>& x,
+                             const std::vector<double>& y,
+                             size_t max_lag,
+                             const std::string& method,
+                             bool remove_missing = true,
+                             size_t num_threads = 0);
+
+//! a (weighted) independence test; see `wdm::Indep_test`.
+class Indep_test {
+public:
+    Indep_test() = delete;
+
+    //! @param x, y input data.
+    //! @param method the dependence measure.
+    //! @param weights an optional vector of weights for the data.
+    //! @param remove_missing if `true`, all observations containing a `nan`
+    //!    are removed; otherwise throws an error if `nan`s are present.
+    //! @param alternative `"two-sided"` (default), `"greater"`, or `"less"`.
+    Indep_test(const std::vector<double>& x,
+               const std::vector<double>& y,
+               const std::string& method,
+               const std::vector<double>& weights = std::vector<double>(),
+               bool remove_missing = true,
+               const std::string& alternative = "two-sided");
+
+    //! the method used for the test.
+    std::string method() const {return method_;}
+
+    //! the alternative hypothesis.
+    std::string alternative() const {return alternative_;}
+
+    //! the effective sample size.
+    double n_eff() const {return n_eff_;}
+
+    //! the estimated dependence measure.
+    double estimate() const {return estimate_;}
+
+    //! the test statistic.
+    double statistic() const {return statistic_;}
+
+    //! the p-value of the test.
+    double p_value() const {return p_value_;}
+
+private:
+    std::string method_;
+    std::string alternative_;
+    double n_eff_;
+    double estimate_;
+    double statistic_;
+    double p_value_;
+};
+
+}
+
+}
@@ -0,0 +1,203 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#include "wdm_c.h"
+#include "wdm.hpp"
+#include "wdm/tiles.hpp"
+
+#include <new>
+
+#ifndef WDM_VERSION
+#define WDM_VERSION "unknown"
+#endif
+
+namespace {
+
+thread_local std::string last_error;
+
+class Null_pointer_error : public std::runtime_error {
+public:
+    explicit Null_pointer_error(const std::string& what) :
+        std::runtime_error(what)
+    {}
+};
+
+inline void check_pointer(const void* p, const char* name)
+{
+    if (!p)
+        throw Null_pointer_error(std::string(name) + " must not be NULL.");
+}
+
+//! copies `n` elements with stride `stride` into a vector; an empty vector
+//! is returned for `NULL` pointers.
+inline std::vector<double> gather(const double* x, ptrdiff_t stride, size_t n)
+{
+    if (!x)
+        return std::vector<double>();
+    std::vector<double> v(n);
+    for (size_t i = 0; i < n; i++)
+        v[i] = x[static_cast<ptrdiff_t>(i) * stride];
+    return v;
+}
+
+//! points to `n` contiguous elements: `x` itself if `stride` is one (or `x`
+//! is `NULL`), otherwise a copy gathered into `buf`.
+inline const double* contiguous(const double* x,
+                                ptrdiff_t stride,
+                                size_t n,
+                                std::vector<double>& buf)
+{
+    if (!x || (stride == 1))
+        return x;
+    buf = gather(x, stride, n);
+    return buf.data();
+}
+
+//! runs `f` and translates exceptions into status codes.
+template<class F>
+wdm_status guard(F f)
+{
+    last_error.clear();
+    try {
+        f();
+        return WDM_OK;
+    } catch (const Null_pointer_error& e) {
+        last_error = e.what();
+        return WDM_ERROR_NULL_POINTER;
+    } catch (const std::bad_alloc&) {
+        last_error = "out of memory.";
+        return WDM_ERROR_OUT_OF_MEMORY;
+    } catch (const std::runtime_error& e) {
+        last_error = e.what();
+        return WDM_ERROR_INVALID_ARGUMENT;
+    } catch (const std::exception& e) {
+        last_error = e.what();
+        return WDM_ERROR_UNKNOWN;
+    } catch (...) {
+        last_error = "unknown error.";
+        return WDM_ERROR_UNKNOWN;
+    }
+}
+
+}
+
+extern "C" {
+
+const char* wdm_version(void)
+{
+    return WDM_VERSION;
+}
+
+const char* wdm_last_error(void)
+{
+    return last_error.c_str();
+}
+
+wdm_status wdm_pair(const double* x, ptrdiff_t x_stride,
+                    const double* y, ptrdiff_t y_stride,
+                    const double* w, ptrdiff_t w_stride,
+                    size_t n,
+                    const char* method,
+                    int remove_missing,
+                    double* out)
+{
+    return guard([&] {
+        check_pointer(method, "method");
+        check_pointer(out, "out");
+        if (n > 0) {
+            check_pointer(x, "x");
+            check_pointer(y, "y");
+        }
+        std::vector<double> x_buf, y_buf, w_buf;
+        *out = wdm::impl::wdm_raw(contiguous(x, x_stride, n, x_buf),
+                                  contiguous(y, y_stride, n, y_buf),
+                                  contiguous(w, w_stride, n, w_buf),
+                                  n, method, remove_missing != 0);
+    });
+}
+
+wdm_status wdm_indep_test(const double* x, ptrdiff_t x_stride,
+                          const double* y, ptrdiff_t y_stride,
+                          const double* w, ptrdiff_t w_stride,
+                          size_t n,
+                          const char* method,
+                          int remove_missing,
+                          const char* alternative,
+                          double* estimate,
+                          double* statistic,
+                          double* p_value)
+{
+    return guard([&] {
+        check_pointer(method, "method");
+        check_pointer(alternative, "alternative");
+        if (n > 0) {
+            check_pointer(x, "x");
+            check_pointer(y, "y");
+        }
+        wdm::Indep_test test(gather(x, x_stride, n),
+                             gather(y, y_stride, n),
+                             method,
+                             gather(w, w_stride, n),
+                             remove_missing != 0,
+                             alternative);
+        if (estimate)
+            *estimate = test.estimate();
+        if (statistic)
+            *statistic = test.statistic();
+        if (p_value)
+            *p_value = test.p_value();
+    });
+}
+
+wdm_status wdm_pair_batch(const double* x,
+                          const double* y,
+                          const double* w,
+                          const size_t* offsets,
+                          size_t num_samples,
+                          const char* method,
+                          int remove_missing,
+                          size_t num_threads,
+                          double* out)
+{
+    return guard([&] {
+        check_pointer(method, "method");
+        check_pointer(offsets, "offsets");
+        if (num_samples == 0)
+            return;
+        check_pointer(out, "out");
+        if (offsets[num_samples] > offsets[0]) {
+            check_pointer(x, "x");
+            check_pointer(y, "y");
+        }
+        std::vector<size_t> offs(offsets, offsets + num_samples + 1);
+        auto res = wdm::wdm_batch(x, y, offs, method, w,
+                                  remove_missing != 0, num_threads);
+        std::copy(res.begin(), res.end(), out);
+    });
+}
+
+wdm_status wdm_matrix(const double* x,
+                      size_t n,
+                      size_t d,
+                      ptrdiff_t row_stride,
+                      ptrdiff_t col_stride,
+                      const double* w,
+                      const char* method,
+                      int remove_missing,
+                      size_t num_threads,
+                      double* out)
+{
+    return guard([&] {
+        check_pointer(method, "method");
+        check_pointer(out, "out");
+        if (n > 0)
+            check_pointer(x, "x");
+        wdm::impl::wdm_matrix(x, n, d, row_stride, col_stride, w, method,
+                              remove_missing != 0, num_threads, out, d, 1);
+    });
+}
+
+}
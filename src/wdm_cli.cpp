@@ -0,0 +1,467 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#include "wdm/columnar.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#ifndef WDM_VERSION
+#define WDM_VERSION "unknown"
+#endif
+
+namespace {
+
+const char* usage =
+"usage: wdm-cli [options] <input> [<input2>]\n"
+"\n"
+"Computes dependence measures between the columns of <input>, a CSV file or\n"
+"a columnar binary file (see wdm::Columnar_file). By default, the full\n"
+"matrix is computed; with <input2>, the cross matrix between the columns of\n"
+"both inputs; with --pair, an independence test for a single pair.\n"
+"\n"
+"options:\n"
+"  -m, --method NAME     dependence measure (default: pearson)\n"
+"  --pair I,J            test a single pair of columns (indices or names)\n"
+"  -w, --weights FILE    weights (first column of a CSV or columnar file)\n"
+"  --keep-missing        fail if there are missing values (default: remove\n"
+"                        them for each pair)\n"
+"  -t, --threads N       number of threads (default: all cores)\n"
+"  -o, --output FILE     output file (default: standard output)\n"
+"  --tiled FILE          write the full matrix to a tiled binary file (see\n"
+"                        wdm::wdm_tiled())\n"
+"  --tile-size N         variables per tile (default: 512)\n"
+"  --float               store tiled output in single precision\n"
+"  --no-header           CSV input has no header row\n"
+"  --delimiter C         field delimiter of CSV input (default: ,)\n"
+"  --timing              print the time spent in each phase to stderr\n"
+"  -h, --help            show this message\n"
+"  --version             show the version\n";
+
+struct Options {
+    std::string method = "pearson";
+    std::vector<std::string> inputs;
+    std::string pair;
+    std::string weights;
+    bool remove_missing = true;
+    size_t num_threads = 0;
+    std::string output;
+    std::string tiled;
+    size_t tile_size = 512;
+    bool single_precision = false;
+    bool header = true;
+    char delimiter = ',';
+    bool timing = false;
+};
+
+//! a data set read from a CSV or columnar file.
+struct Dataset {
+    std::vector<std::string> names;
+    std::vector<std::vector<double>> cols;     // CSV input
+    std::unique_ptr<wdm::Columnar_file> file;  // columnar input
+
+    size_t n() const { return file ? file->n() : (cols.empty() ? 0 : cols[0].size()); }
+    size_t d() const { return names.size(); }
+
+    std::vector<double> column(size_t j) const
+    {
+        return file ? file->column(j) : cols[j];
+    }
+};
+
+//! wall-clock times of the phases of a job.
+class Timer {
+public:
+    void start(std::string phase)
+    {
+        phase_ = phase;
+        t0_ = std::chrono::steady_clock::now();
+    }
+
+    void stop()
+    {
+        std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0_;
+        times_.push_back(std::make_pair(phase_, dt.count()));
+    }
+
+    const std::vector<std::pair<std::string, double>>& times() const
+    {
+        return times_;
+    }
+
+private:
+    std::string phase_;
+    std::chrono::steady_clock::time_point t0_;
+    std::vector<std::pair<std::string, double>> times_;
+};
+
+size_t parse_size(const std::string& s, const std::string& option)
+{
+    char* end;
+    long long v = std::strtoll(s.c_str(), &end, 10);
+    if (s.empty() || (*end != '\0') || (v < 0))
+        throw std::runtime_error("invalid value for " + option + ": " + s);
+    return static_cast<size_t>(v);
+}
+
+Options parse_args(int argc, char** argv)
+{
+    Options opts;
+    auto value = [&] (int& k) {
+        if (k + 1 >= argc)
+            throw std::runtime_error(std::string("missing value for ") + argv[k]);
+        return std::string(argv[++k]);
+    };
+    for (int k = 1; k < argc; k++) {
+        std::string arg = argv[k];
+        if ((arg == "-h") || (arg == "--help")) {
+            std::cout << usage;
+            std::exit(0);
+        } else if (arg == "--version") {
+            std::cout << "wdm-cli " << WDM_VERSION << std::endl;
+            std::exit(0);
+        } else if ((arg == "-m") || (arg == "--method")) {
+            opts.method = value(k);
+        } else if (arg == "--pair") {
+            opts.pair = value(k);
+        } else if ((arg == "-w") || (arg == "--weights")) {
+            opts.weights = value(k);
+        } else if (arg == "--keep-missing") {
+            opts.remove_missing = false;
+        } else if ((arg == "-t") || (arg == "--threads")) {
+            opts.num_threads = parse_size(value(k), arg);
+        } else if ((arg == "-o") || (arg == "--output")) {
+            opts.output = value(k);
+        } else if (arg == "--tiled") {
+            opts.tiled = value(k);
+        } else if (arg == "--tile-size") {
+            opts.tile_size = parse_size(value(k), arg);
+        } else if (arg == "--float") {
+            opts.single_precision = true;
+        } else if (arg == "--no-header") {
+            opts.header = false;
+        } else if (arg == "--delimiter") {
+            std::string d = value(k);
+            if (d.size() != 1)
+                throw std::runtime_error("the delimiter must be a single character.");
+            opts.delimiter = d[0];
+        } else if (arg == "--timing") {
+            opts.timing = true;
+        } else if ((arg.size() > 1) && (arg[0] == '-')) {
+            throw std::runtime_error("unknown option: " + arg);
+        } else {
+            opts.inputs.push_back(arg);
+        }
+    }
+    if ((opts.inputs.size() < 1) || (opts.inputs.size() > 2))
+        throw std::runtime_error("expected one or two input files.");
+    if (!opts.pair.empty() && (opts.inputs.size() > 1))
+        throw std::runtime_error("--pair requires a single input.");
+    if (!opts.tiled.empty() && (!opts.pair.empty() || (opts.inputs.size() > 1)))
+        throw std::runtime_error("--tiled is only available for the full matrix.");
+    return opts;
+}
+
+//! removes surrounding white space and quotes from a CSV field.
+std::string trim(const std::string& field)
+{
+    size_t b = field.find_first_not_of(" \t\r\"");
+    if (b == std::string::npos)
+        return std::string();
+    return field.substr(b, field.find_last_not_of(" \t\r\"") - b + 1);
+}
+
+//! parses a CSV field; empty fields and `NA`/`NaN` are missing.
+bool parse_field(const std::string& field, double& value)
+{
+    std::string s = trim(field);
+    if (s.empty() || (s == "NA") || (s == "NaN") || (s == "nan")) {
+        value = std::numeric_limits<double>::quiet_NaN();
+        return true;
+    }
+    char* end;
+    value = std::strtod(s.c_str(), &end);
+    return *end == '\0';
+}
+
+//! splits a line into fields.
+void split(const std::string& line, char delimiter, std::vector<std::string>& fields)
+{
+    fields.clear();
+    size_t start = 0;
+    while (true) {
+        size_t pos = line.find(delimiter, start);
+        fields.push_back(line.substr(start, pos - start));
+        if (pos == std::string::npos)
+            break;
+        start = pos + 1;
+    }
+}
+
+//! reads a CSV file line by line directly into columns.
+void read_csv(const std::string& path, const Options& opts, Dataset& data)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("cannot open '" + path + "'.");
+    std::string line;
+    std::vector<std::string> fields;
+    size_t line_no = 0;
+    while (std::getline(file, line)) {
+        line_no++;
+        if (line.empty() || (line == "\r"))
+            continue;
+        split(line, opts.delimiter, fields);
+        if (data.names.empty()) {
+            for (size_t j = 0; j < fields.size(); j++) {
+                data.names.push_back(opts.header ? trim(fields[j]) :
+                                     "V" + std::to_string(j + 1));
+            }
+            data.cols.resize(fields.size());
+            if (opts.header)
+                continue;
+        }
+        if (fields.size() != data.d()) {
+            throw std::runtime_error(path + ":" + std::to_string(line_no) +
+                                     ": expected " + std::to_string(data.d()) +
+                                     " fields.");
+        }
+        for (size_t j = 0; j < fields.size(); j++) {
+            double v;
+            if (!parse_field(fields[j], v)) {
+                throw std::runtime_error(path + ":" + std::to_string(line_no) +
+                                         ": invalid number '" + fields[j] + "'.");
+            }
+            data.cols[j].push_back(v);
+        }
+    }
+}
+
+Dataset read_input(const std::string& path, const Options& opts)
+{
+    Dataset data;
+    char magic[sizeof(wdm::impl::columnar_magic)] = {};
+    std::ifstream probe(path, std::ios::binary);
+    if (!probe)
+        throw std::runtime_error("cannot open '" + path + "'.");
+    probe.read(magic, sizeof(magic));
+    if (std::memcmp(magic, wdm::impl::columnar_magic, sizeof(magic)) == 0) {
+        data.file.reset(new wdm::Columnar_file(path));
+        for (size_t j = 0; j < data.file->d(); j++)
+            data.names.push_back("V" + std::to_string(j + 1));
+    } else {
+        read_csv(path, opts, data);
+    }
+    return data;
+}
+
+//! finds a column by name or (one-based) index.
+size_t find_column(const Dataset& data, const std::string& key)
+{
+    for (size_t j = 0; j < data.d(); j++) {
+        if (data.names[j] == key)
+            return j;
+    }
+    char* end;
+    long long j = std::strtoll(key.c_str(), &end, 10);
+    if (key.empty() || (*end != '\0') || (j < 1) ||
+        (static_cast<size_t>(j) > data.d()))
+        throw std::runtime_error("unknown column: " + key);
+    return static_cast<size_t>(j - 1);
+}
+
+//! computes the cross matrix between the columns of two data sets.
+Eigen::MatrixXd cross(const Dataset& x, const Dataset& y,
+                      const Eigen::VectorXd& weights, const Options& opts)
+{
+    if (x.file && y.file) {
+        return wdm::wdm(*x.file, *y.file, opts.method, weights,
+                        opts.remove_missing, opts.num_threads);
+    }
+    if (x.n() != y.n())
+        throw std::runtime_error("x and y must have the same number of rows.");
+    auto w = wdm::utils::convert_vec(weights);
+    Eigen::MatrixXd ms(x.d(), y.d());
+    wdm::utils::parallel_for(x.d() * y.d(), opts.num_threads, [&] (size_t k, size_t) {
+        size_t i = k / y.d(), j = k % y.d();
+        ms(i, j) = wdm::wdm(x.column(i), y.column(j), opts.method, w,
+                            opts.remove_missing);
+    });
+    return ms;
+}
+
+//! computes the full matrix of a data set.
+Eigen::MatrixXd matrix(const Dataset& x,
+                       const Eigen::VectorXd& weights,
+                       const Options& opts)
+{
+    if (x.file) {
+        return wdm::wdm(*x.file, opts.method, weights, opts.remove_missing,
+                        opts.num_threads);
+    }
+    Eigen::MatrixXd ms(x.d(), x.d());
+    bool symmetric = wdm::methods::is_symmetric(opts.method);
+    wdm::impl::wdm_tiles(
+        [&x] (size_t j) { return x.cols[j]; },
+        x.n(), x.d(), opts.method, wdm::utils::convert_vec(weights),
+        opts.remove_missing, opts.tile_size, opts.num_threads,
+        [&] (const wdm::Matrix_tile& tile) {
+            for (size_t i = tile.row_begin; i < tile.row_end; i++) {
+                for (size_t j = tile.col_begin; j < tile.col_end; j++) {
+                    ms(i, j) = tile(i, j);
+                    if (symmetric)
+                        ms(j, i) = tile(i, j);
+                }
+            }
+        });
+    return ms;
+}
+
+void write_matrix(std::ostream& out,
+                  const Eigen::MatrixXd& ms,
+                  const std::vector<std::string>& row_names,
+                  const std::vector<std::string>& col_names)
+{
+    out << std::setprecision(10);
+    out << "\"\"";
+    for (const auto& name : col_names)
+        out << ",\"" << name << "\"";
+    out << "\n";
+    for (size_t i = 0; i < row_names.size(); i++) {
+        out << "\"" << row_names[i] << "\"";
+        for (size_t j = 0; j < col_names.size(); j++)
+            out << "," << ms(i, j);
+        out << "\n";
+    }
+}
+
+int run(const Options& opts)
+{
+    Timer timer;
+    std::map<std::string, wdm::profiling::Phase_stats> profile;
+    std::mutex profile_mutex;
+    if (opts.timing) {
+        // library phases are only recorded if built with WDM_PROFILING
+        wdm::profiling::set_callback([&] (const wdm::profiling::Phase_stats& s) {
+            std::lock_guard<std::mutex> lk(profile_mutex);
+            auto& p = profile[s.phase];
+            p.phase = s.phase;
+            p.calls += s.calls;
+            p.seconds += s.seconds;
+        });
+    }
+
+    timer.start("read");
+    std::vector<Dataset> data;
+    for (const auto& path : opts.inputs)
+        data.push_back(read_input(path, opts));
+    Eigen::VectorXd weights;
+    if (!opts.weights.empty()) {
+        Dataset w = read_input(opts.weights, opts);
+        auto col = (w.d() > 0) ? w.column(0) : std::vector<double>();
+        weights = Eigen::Map<Eigen::VectorXd>(col.data(), col.size());
+    }
+    timer.stop();
+
+    std::ofstream file;
+    if (!opts.output.empty()) {
+        file.open(opts.output);
+        if (!file)
+            throw std::runtime_error("cannot open '" + opts.output + "' for writing.");
+    }
+    std::ostream& out = opts.output.empty() ? std::cout : file;
+
+    size_t num_pairs = 0;
+    const Dataset& x = data[0];
+    size_t num_matrix_pairs = x.d() * (x.d() - 1);
+    if (wdm::methods::is_symmetric(opts.method))
+        num_matrix_pairs /= 2;
+    if (!opts.pair.empty()) {
+        size_t comma = opts.pair.find(',');
+        if (comma == std::string::npos)
+            throw std::runtime_error("--pair expects two columns I,J.");
+        size_t i = find_column(x, opts.pair.substr(0, comma));
+        size_t j = find_column(x, opts.pair.substr(comma + 1));
+        timer.start("compute");
+        wdm::Indep_test test(x.column(i), x.column(j), opts.method,
+                             wdm::utils::convert_vec(weights),
+                             opts.remove_missing);
+        timer.stop();
+        timer.start("write");
+        out << std::setprecision(10);
+        out << "x,y,method,estimate,statistic,p_value\n";
+        out << "\"" << x.names[i] << "\",\"" << x.names[j] << "\"," <<
+            opts.method << "," << test.estimate() << "," <<
+            test.statistic() << "," << test.p_value() << "\n";
+        timer.stop();
+        num_pairs = 1;
+    } else if (data.size() == 2) {
+        timer.start("compute");
+        auto ms = cross(x, data[1], weights, opts);
+        timer.stop();
+        timer.start("write");
+        write_matrix(out, ms, x.names, data[1].names);
+        timer.stop();
+        num_pairs = x.d() * data[1].d();
+    } else if (!opts.tiled.empty()) {
+        timer.start("compute");
+        wdm::impl::write_tiles(
+            [&x] (size_t j) { return x.column(j); },
+            x.n(), x.d(), opts.method, wdm::utils::convert_vec(weights),
+            opts.remove_missing, opts.tile_size, opts.num_threads,
+            opts.tiled, opts.single_precision);
+        timer.stop();
+        num_pairs = num_matrix_pairs;
+    } else {
+        timer.start("compute");
+        auto ms = matrix(x, weights, opts);
+        timer.stop();
+        timer.start("write");
+        write_matrix(out, ms, x.names, x.names);
+        timer.stop();
+        num_pairs = num_matrix_pairs;
+    }
+    out.flush();
+
+    if (opts.timing) {
+        wdm::profiling::set_callback(wdm::profiling::Callback());
+        double total = 0.0, compute = 0.0;
+        std::cerr << std::setprecision(6);
+        std::cerr << "phase,seconds\n";
+        for (const auto& t : timer.times()) {
+            std::cerr << t.first << "," << t.second << "\n";
+            total += t.second;
+            if (t.first == "compute")
+                compute = t.second;
+        }
+        std::cerr << "total," << total << "\n";
+        std::cerr << "# n = " << x.n() << ", pairs = " << num_pairs <<
+            ", pairs/s = " << num_pairs / compute << "\n";
+        for (const auto& p : profile) {
+            std::cerr << "# " << p.first << ": " << p.second.calls <<
+                " calls, " << p.second.seconds << " s (summed over threads)\n";
+        }
+    }
+
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    try {
+        return run(parse_args(argc, argv));
+    } catch (const std::exception& e) {
+        std::cerr << "wdm-cli: " << e.what() << "\n";
+        return 1;
+    }
+}
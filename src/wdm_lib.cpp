@@ -0,0 +1,83 @@
+// Copyright © 2020 Thomas Nagler
+//
+// This file is part of the wdm library and licensed under the terms of
+// the MIT license. For a copy, see the LICENSE file in the root directory
+// or https://github.com/tnagler/wdm/blob/master/LICENSE.
+
+#include "wdm_lib.hpp"
+#include "wdm.hpp"
+#include "wdm/tiles.hpp"
+
+namespace wdm {
+
+// kernels shared with translation units that include the headers and link
+// against this library (see wdm/instantiations.hpp)
+WDM_KERNEL_INSTANTIATIONS(template, utils::Weighted)
+WDM_KERNEL_INSTANTIATIONS(template, utils::Unweighted)
+
+namespace lib {
+
+double wdm(const std::vector<double>& x,
+           const std::vector<double>& y,
+           const std::string& method,
+           const std::vector<double>& weights,
+           bool remove_missing)
+{
+    return ::wdm::wdm(x, y, method, weights, remove_missing);
+}
+
+std::vector<double> wdm_batch(const std::vector<double>& x,
+                              const std::vector<double>& y,
+                              const std::vector<size_t>& offsets,
+                              const std::string& method,
+                              const std::vector<double>& weights,
+                              bool remove_missing,
+                              size_t num_threads)
+{
+    return ::wdm::wdm_batch(x, y, offsets, method, weights, remove_missing,
+                            num_threads);
+}
+
+std::vector<double> wdm_matrix(const double* x,
+                               size_t n,
+                               size_t d,
+                               const std::string& method,
+                               const double* weights,
+                               bool remove_missing,
+                               size_t num_threads)
+{
+    std::vector<double> ms(d * d);
+    impl::wdm_matrix(x, n, d, 1, static_cast<ptrdiff_t>(n), weights, method,
+                     remove_missing, num_threads, ms.data(), 1, d);
+    return ms;
+}
+
+std::vector<double> wdm_lags(const std::vector<double>& x,
+                             const std::vector<double>& y,
+                             size_t max_lag,
+                             const std::string& method,
+                             bool remove_missing,
+                             size_t num_threads)
+{
+    return ::wdm::wdm_lags(x, y, max_lag, method, remove_missing, num_threads);
+}
+
+Indep_test::Indep_test(const std::vector<double>& x,
+                       const std::vector<double>& y,
+                       const std::string& method,
+                       const std::vector<double>& weights,
+                       bool remove_missing,
+                       const std::string& alternative)
+{
+    ::wdm::Indep_test test(x, y, method, weights, remove_missing, alternative);
+    method_ = test.method();
+    alternative_ = test.alternative();
+    n_eff_ = test.n_eff();
+    estimate_ = test.estimate();
+    statistic_ = test.statistic();
+    p_value_ = test.p_value();
+}
+
+}
+
+}
@@ -9,8 +9,322 @@ int main(int argc, char **argv) {
 //#include <wdm/include/wdm.hpp>
 #include <wdm.hpp>
 #include <iostream>
+#include <cmath>
+#include <cstdio>
+
+#ifdef WDM_TEST_EIGEN
+#include <wdm/columnar.hpp>
+#include <wdm/tiled.hpp>
+#endif
+
+// checks ranks on tie-heavy (zero-inflated) data, where a single tie group
+// holds most of the observations; ranking must stay linear in the group size.
+bool check_heavy_ties() {
+    size_t n = 200000;
+    std::vector<double> x(n), w(n);
+    for (size_t i = 0; i < n; i++) {
+        x[i] = (i % 10 == 0) ? static_cast<double>(i % 7) : 0.0;
+        w[i] = 1.0 + static_cast<double>(i % 3);
+    }
+
+    // unweighted: average ranks are the means of the ranks within a group,
+    // the other methods permute them
+    auto r_min = wdm::impl::rank(x, {}, "min");
+    auto r_avg = wdm::impl::rank(x, {}, "average");
+    auto r_first = wdm::impl::rank(x, {}, "first");
+    auto r_rand = wdm::impl::rank(x, {}, "random", {1, 2});
+    auto r0_avg = wdm::impl::rank0(x, {}, "average");
+    double s_avg = 0, s_first = 0, s_rand = 0;
+    for (size_t i = 0; i < n; i++) {
+        s_avg += r_avg[i];
+        s_first += r_first[i];
+        s_rand += r_rand[i];
+        if ((r0_avg[i] != r_avg[i] - 1) || (r_first[i] < r_min[i]))
+            return false;
+    }
+    double s_all = 0.5 * n * (n + 1.0);
+    if ((s_avg != s_all) || (s_first != s_all) || (s_rand != s_all))
+        return false;
+
+    // weighted: the linear-time average ranks agree with the pairwise
+    // kernel for small samples
+    std::vector<double> xs(x.begin(), x.begin() + 60), ws(w.begin(), w.begin() + 60);
+    auto r_small = wdm::impl::rank0(xs, ws, "average");
+    auto r_order = wdm::impl::rank0_from_order(xs, wdm::utils::get_order(xs),
+                                               ws, "average");
+    for (size_t i = 0; i < xs.size(); i++) {
+        if (std::fabs(r_small[i] - r_order[i]) > 1e-12)
+            return false;
+    }
+
+    // dependence measures and tests on heavily tied data
+    std::vector<double> y(n);
+    for (size_t i = 0; i < n; i++)
+        y[i] = (i % 4 == 0) ? x[i] + static_cast<double>(i % 5) : 0.0;
+    for (std::string method : {"kendall", "spearman", "blomqvist", "hoeffding"}) {
+        if (!std::isfinite(wdm::wdm(x, y, method, w)))
+            return false;
+    }
+
+    return true;
+}
+
+// checks Hoeffding's D on tied data against the direct formula, where ties
+// count by one half in one and by one quarter in both variables.
+bool check_hoeffding_ties() {
+    for (size_t n : {10, 100}) {
+        for (size_t levels : {2, 3, 10}) {
+            std::vector<double> x(n), y(n);
+            for (size_t i = 0; i < n; i++) {
+                x[i] = static_cast<double>((i * 7) % levels);
+                y[i] = (i % 3 == 0) ? x[i] : static_cast<double>((i * 5 + 1) % levels);
+            }
+
+            double nn = static_cast<double>(n), D1 = 0, D2 = 0, D3 = 0;
+            for (size_t i = 0; i < n; i++) {
+                double R = 1, S = 1, Q = 1;
+                for (size_t j = 0; j < n; j++) {
+                    if (j == i)
+                        continue;
+                    double cx = (x[j] < x[i]) ? 1.0 : ((x[j] == x[i]) ? 0.5 : 0.0);
+                    double cy = (y[j] < y[i]) ? 1.0 : ((y[j] == y[i]) ? 0.5 : 0.0);
+                    R += cx;
+                    S += cy;
+                    Q += cx * cy;
+                }
+                D1 += (Q - 1) * (Q - 2);
+                D2 += (R - 1) * (R - 2) * (S - 1) * (S - 2);
+                D3 += (R - 2) * (S - 2) * (Q - 1);
+            }
+            double D = 30 * ((nn - 2) * (nn - 3) * D1 + D2 - 2 * (nn - 2) * D3) /
+                (nn * (nn - 1) * (nn - 2) * (nn - 3) * (nn - 4));
+
+            double res = wdm::wdm(x, y, "hoeffding");
+            auto res_multi = wdm::wdm_multi(x, y, "hoeffding", {std::vector<double>(n, 1.0)});
+            if ((res > 1) || (std::fabs(res - D) > 1e-12) ||
+                (std::fabs(res_multi[0] - D) > 1e-12))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// checks that each hint leaves the results unchanged on data for which it
+// holds, below and above the size where the small-sample kernels are used.
+bool check_hints() {
+    for (size_t n : {40, 300}) {
+        // x is sorted, both variables are ranks without ties, and the weights
+        // sum to one
+        std::vector<double> x(n), y(n), w(n);
+        for (size_t i = 0; i < n; i++) {
+            x[i] = static_cast<double>(i + 1);
+            y[i] = static_cast<double>((i * 7 + 3) % n + 1);
+            w[i] = 1.0 + static_cast<double>(i % 3);
+        }
+        double w_sum = wdm::utils::sum(w);
+        for (auto& wi : w)
+            wi /= w_sum;
+
+        std::vector<wdm::Data_hints> all_hints(6);
+        all_hints[0].no_missing = true;
+        all_hints[1].sorted = true;
+        all_hints[2].no_ties = true;
+        all_hints[3].ranked = true;
+        all_hints[4].normalized_weights = true;
+        all_hints[5].no_missing = all_hints[5].sorted = all_hints[5].no_ties =
+            all_hints[5].ranked = all_hints[5].normalized_weights = true;
+
+        auto close = [] (double a, double b) {
+            return std::fabs(a - b) <= 1e-10 * (1.0 + std::fabs(b));
+        };
+        for (std::string method : {"kendall", "spearman", "pearson",
+                                   "blomqvist", "hoeffding", "distance", "xi"}) {
+            for (const auto& weights : {std::vector<double>(), w}) {
+                std::string alternative = wdm::methods::is_xi(method) ?
+                    "greater" : "two-sided";
+                double ref = wdm::wdm(x, y, method, weights);
+                wdm::Indep_test ref_test(x, y, method, weights, true, alternative);
+                for (const auto& hints : all_hints) {
+                    wdm::Indep_test test(x, y, method, weights, true,
+                                         alternative, hints);
+                    if (!close(wdm::wdm(x, y, method, weights, true, hints), ref) ||
+                        !close(test.estimate(), ref_test.estimate()) ||
+                        !close(test.statistic(), ref_test.statistic()) ||
+                        !close(test.p_value(), ref_test.p_value()))
+                        return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// checks the null distributions of Kendall's tau and Spearman's rho against
+// enumeration of all permutations, and that aggregate tests use them as well.
+bool check_exact_null() {
+    for (size_t n = 1; n <= 8; n++) {
+        size_t max_d = n * (n - 1) / 2, max_h = (n * n * n - n) / 6;
+        std::vector<double> count_d(max_d + 1, 0.0), count_h(max_h + 1, 0.0);
+        std::vector<size_t> r(n);
+        for (size_t i = 0; i < n; i++)
+            r[i] = i;
+        double num_perms = 0;
+        do {
+            // discordant pairs and the sum of squared rank differences
+            size_t d = 0, s = 0;
+            for (size_t i = 0; i < n; i++) {
+                for (size_t j = i + 1; j < n; j++)
+                    d += (r[i] > r[j]);
+                size_t diff = (r[i] > i) ? r[i] - i : i - r[i];
+                s += diff * diff;
+            }
+            count_d[d]++;
+            count_h[s / 2]++;
+            num_perms++;
+        } while (std::next_permutation(r.begin(), r.end()));
+
+        const auto& cdf_d = wdm::impl::ktau_null_table()[n];
+        const auto& cdf_h = wdm::impl::srho_null_table()[n];
+        if ((cdf_d.size() != max_d + 1) || (cdf_h.size() != max_h + 1))
+            return false;
+        double c_d = 0, c_h = 0;
+        for (size_t k = 0; k <= max_d; k++) {
+            c_d += count_d[k];
+            if (std::fabs(cdf_d[k] - c_d / num_perms) > 1e-12)
+                return false;
+        }
+        for (size_t k = 0; k <= max_h; k++) {
+            c_h += count_h[k];
+            if (std::fabs(cdf_h[k] - c_h / num_perms) > 1e-12)
+                return false;
+        }
+    }
+
+    // a small sample without ties: tests built from precomputed estimates
+    // use the same p-values as the test from data
+    std::vector<double> x(20), y(20);
+    for (size_t i = 0; i < 20; i++) {
+        x[i] = static_cast<double>((i * 7) % 20);
+        y[i] = static_cast<double>((i * 11 + 3) % 20) + 0.5 * x[i];
+    }
+    for (std::string method : {"kendall", "spearman"}) {
+        wdm::Indep_test test(x, y, method);
+        auto all = wdm::wdm_all(x, y, {method});
+        if (std::fabs(test.p_value() - all[0].p_value()) > 1e-15)
+            return false;
+    }
+
+    return true;
+}
+
+#ifdef WDM_TEST_EIGEN
+// checks that tiled files hold the same matrix as wdm(), with tiles that do
+// not divide the number of variables.
+bool check_tiled() {
+    Eigen::MatrixXd x(60, 7);
+    for (Eigen::Index i = 0; i < x.rows(); i++) {
+        for (Eigen::Index j = 0; j < x.cols(); j++)
+            x(i, j) = std::sin(static_cast<double>((i + 1) * (j + 2))) + 0.1 * j * i;
+    }
+
+    std::string path = "test_wdm_tiled.bin";
+    bool ok = true;
+    for (std::string method : {"kendall", "xi"}) {
+        Eigen::MatrixXd ref = wdm::wdm(x, method);
+        for (bool single_precision : {false, true}) {
+            wdm::wdm_tiled(x, method, path, Eigen::VectorXd(), true,
+                           single_precision, 3);
+            Eigen::MatrixXd ms = wdm::read_tiled(path);
+            double tol = single_precision ? 1e-6 : 1e-12;
+            if ((ms.rows() != ref.rows()) || (ms.cols() != ref.cols()) ||
+                ((ms - ref).cwiseAbs().maxCoeff() > tol))
+                ok = false;
+        }
+    }
+    std::remove(path.c_str());
+
+    return ok;
+}
+
+// checks that columnar files, with and without validity bitmaps, give the
+// same matrices as the data in memory.
+bool check_columnar() {
+    Eigen::MatrixXd x(80, 5);
+    for (Eigen::Index i = 0; i < x.rows(); i++) {
+        for (Eigen::Index j = 0; j < x.cols(); j++)
+            x(i, j) = std::cos(static_cast<double>((i + 3) * (j + 1))) + 0.05 * i;
+    }
+    for (Eigen::Index i = 0; i < x.rows(); i += 7)
+        x(i, 2) = std::numeric_limits<double>::quiet_NaN();
+
+    std::string path = "test_wdm_columnar.bin";
+    bool ok = true;
+    for (bool validity : {false, true}) {
+        wdm::write_columnar(x, path, validity);
+        {
+            wdm::Columnar_file file(path);
+            if ((file.n() != 80) || (file.d() != 5) ||
+                (file.has_validity() != validity) || file.is_complete(2) ||
+                !file.is_complete(1) || (validity && file.is_valid(7, 2)) ||
+                !std::isnan(file.column(2)[14]))
+                ok = false;
+            // Pearson's correlation of complete columns is computed on the
+            // mapping directly
+            for (std::string method : {"pearson", "kendall", "xi"}) {
+                Eigen::MatrixXd ref = wdm::wdm(x, method);
+                if ((wdm::wdm(file, method) - ref).cwiseAbs().maxCoeff() > 1e-12)
+                    ok = false;
+                // the diagonal of the cross matrix holds the measures of each
+                // column with itself
+                Eigen::MatrixXd cross = wdm::wdm(file, file, method);
+                for (Eigen::Index j = 0; j < x.cols(); j++) {
+                    std::vector<double> xj(x.col(j).data(),
+                                           x.col(j).data() + x.rows());
+                    if (std::fabs(cross(j, j) - wdm::wdm(xj, xj, method)) > 1e-12)
+                        ok = false;
+                    cross(j, j) = 1.0;
+                }
+                if ((cross - ref).cwiseAbs().maxCoeff() > 1e-12)
+                    ok = false;
+            }
+        }
+        std::remove(path.c_str());
+    }
+
+    return ok;
+}
+#endif
 
 int main() {
+    if (!check_heavy_ties()) {
+        std::cout << "ranks on tie-heavy data are inconsistent" << std::endl;
+        return 1;
+    }
+    if (!check_hoeffding_ties()) {
+        std::cout << "Hoeffding's D on tied data is inconsistent" << std::endl;
+        return 1;
+    }
+    if (!check_hints()) {
+        std::cout << "hinted and unhinted results are inconsistent" << std::endl;
+        return 1;
+    }
+#ifdef WDM_TEST_EIGEN
+    if (!check_tiled()) {
+        std::cout << "tiled files do not round-trip" << std::endl;
+        return 1;
+    }
+    if (!check_columnar()) {
+        std::cout << "columnar files do not round-trip" << std::endl;
+        return 1;
+    }
+#endif
+    if (!check_exact_null()) {
+        std::cout << "exact null distributions are inconsistent" << std::endl;
+        return 1;
+    }
+
     // input vectors
     std::vector<double> x{1, 3, 2, 5, 3, 2, 20, 15};
     std::vector<double> y{2, 12, 4, 7, 8, 14, 17, 6};